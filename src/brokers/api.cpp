@@ -9,6 +9,11 @@
 #include "api.h"
 
 #include <sys/stat.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
 #include <unordered_map>
 #include <imtjson/string.h>
 #include <imtjson/array.h>
@@ -18,6 +23,7 @@
 #include <imtjson/binary.h>
 
 #include "../main/istockapi.cpp"
+#include "../main/packeddata.h"
 #include "../shared/stdLogOutput.h"
 using namespace json;
 
@@ -115,6 +121,38 @@ static Value getTicker(AbstractBrokerAPI &handler, const Value &req) {
 }
 
 
+static Value getSnapshot(AbstractBrokerAPI &handler, const Value &req) {
+	AbstractBrokerAPI::Snapshot snp(handler.getSnapshot(req["pair"].getString(),
+			req["asset"].getString(),
+			req["currency"].getString(),
+			req["lastId"]));
+	Array orders;
+	orders.reserve(snp.orders.size());
+	for (auto &&itm:snp.orders) {
+		orders.push_back(Object({
+				{"id",itm.id},
+				{"clientOrderId",itm.client_id},
+				{"size",itm.size},
+				{"price",itm.price}}));
+	}
+	Array trades;
+	trades.reserve(snp.trades.trades.size());
+	for (auto &&itm: snp.trades.trades) {
+		trades.push_back(itm.toJSON());
+	}
+	return Object({
+		{"orders", orders},
+		{"trades", Object({{"trades",trades},{"lastId", snp.trades.lastId}})},
+		{"asset", snp.assetBalance},
+		{"currency", snp.currencyBalance},
+		{"ticker", Object({
+				{"bid", snp.ticker.bid},
+				{"ask", snp.ticker.ask},
+				{"last", snp.ticker.last},
+				{"timestamp",snp.ticker.time}})}
+	});
+}
+
 static Value placeOrder(AbstractBrokerAPI &handler, const Value &req) {
 	return handler.placeOrder(req["pair"].getString(),
 			req["size"].getNumber(),
@@ -261,10 +299,19 @@ Value downloadMinuteData(AbstractBrokerAPI &handler, const Value &req) {
 				req["time_from"].getUIntLong(),
 				req["time_to"].getUIntLong(), vect);
 
-	return Object{
-		{"start", start_time},
-		{"data",std::visit(HistDataVisitor(), vect)}
-	};
+	if (handler.packed_mode) {
+		static_assert(sizeof(AbstractBrokerAPI::OHLC) == 4*sizeof(double));
+		return Object{
+			{"start", start_time},
+			{"data",std::visit([](const auto &x){return packData(x);}, vect)},
+			{"ohlc",std::holds_alternative<AbstractBrokerAPI::OHLCData>(vect)}
+		};
+	} else {
+		return Object{
+			{"start", start_time},
+			{"data",std::visit(HistDataVisitor(), vect)}
+		};
+	}
 }
 
 
@@ -273,14 +320,33 @@ Value enableBinary(AbstractBrokerAPI &handle, const Value &) {
 	return json::undefined;
 }
 
+Value enablePacked(AbstractBrokerAPI &handle, const Value &) {
+	handle.packed_mode = true;
+	return true;
+}
+
+Value enableMux(AbstractBrokerAPI &handle, const Value &) {
+	if (handle.concurrentRequests() < 2) throw std::runtime_error("Method not implemented");
+	handle.mux_mode = true;
+	return true;
+}
+
 Value handleSubaccount(AbstractBrokerAPI &handler, const Value &req) {
-	static std::unordered_map<Value, std::unique_ptr<AbstractBrokerAPI> > subList;
+	//requests can run concurrently (multiplexed mode). The subaccount is held by the request,
+	//so "erase" doesn't destroy it while it is in use, and calls of one subaccount are serialized
+	struct Subaccount {
+		std::mutex lock;
+		std::unique_ptr<AbstractBrokerAPI> api;
+		bool keys_loaded = false;
+	};
+	static std::unordered_map<Value, std::shared_ptr<Subaccount> > subList;
+	static std::recursive_mutex subLock;
+	std::unique_lock _(subLock);
 	if (req.hasValue()) {
 		Value id = req[0];
 		Value cmd = req[1];
 		auto cmdstr = cmd.getString();
 		Value args = req[2];
-		bool loadK = false;
 		if (cmdstr == "erase") {
 			subList.erase(id);
 			return Value();
@@ -289,11 +355,15 @@ Value handleSubaccount(AbstractBrokerAPI &handler, const Value &req) {
 			if (iter == subList.end()) {
 				std::unique_ptr<AbstractBrokerAPI> newptr(handler.createSubaccount(handler.secure_storage_path+"-"+id.toString().c_str()));
 				if (newptr == nullptr) throw std::runtime_error("Subaccounts are not supported");
-				iter = subList.emplace(id, std::move(newptr)).first;
-				loadK = true;
+				auto sub = std::make_shared<Subaccount>();
+				sub->api = std::move(newptr);
+				iter = subList.emplace(id, std::move(sub)).first;
 			}
 
-			auto &p = iter->second;
+			std::shared_ptr<Subaccount> sub = iter->second;
+			_.unlock();
+			std::lock_guard __(sub->lock);
+			auto &p = sub->api;
 
 			class LogCleanup{
 			public:
@@ -303,12 +373,16 @@ Value handleSubaccount(AbstractBrokerAPI &handler, const Value &req) {
 			};
 
 			p->logStream = handler.logStream;
+			p->packed_mode = handler.packed_mode;
 			LogCleanup cleanUp(p);
 
 			p->flushMessages();
-			if (loadK) p->loadKeys();
+			if (!sub->keys_loaded) {
+				p->loadKeys();
+				sub->keys_loaded = true;
+			}
 			if (cmdstr == "getBrokerInfo") {
-				Value v = getBrokerInfo(*iter->second, args);
+				Value v = getBrokerInfo(*p, args);
 				return v.replace("subaccounts", false);
 			} else if (cmdstr == "subaccount") {
 				throw std::runtime_error("Can't access subaccount under subaccount");
@@ -332,6 +406,7 @@ static MethodMap methodMap ({
 			{"syncTrades",&syncTrades},
 			{"getOpenOrders",&getOpenOrders},
 			{"getTicker",&getTicker},
+			{"getSnapshot",&getSnapshot},
 			{"placeOrder",&placeOrder},
 			{"reset",&reset},
 			{"getAllPairs",&getAllPairs},
@@ -351,6 +426,8 @@ static MethodMap methodMap ({
 			{"areMinuteDataAvailable",&areMinuteDataAvailable},
 			{"downloadMinuteData",&downloadMinuteData},
 			{"bin",&enableBinary},
+			{"mux",&enableMux},
+			{"packed",&enablePacked},
 
 	});
 
@@ -393,7 +470,7 @@ void AbstractBrokerAPI::dispatch(std::istream& input, std::ostream& output, std:
 		while (true) {
 			if (!inited) {
 				auto cmd = v[0].getString();
-				if (cmd != "bin" && cmd != "enableDebug") {
+				if (cmd != "bin" && cmd != "enableDebug" && cmd != "mux" && cmd != "packed") {
 					handler.loadKeys();
 					handler.onInit();
 					inited = true;
@@ -408,6 +485,10 @@ void AbstractBrokerAPI::dispatch(std::istream& input, std::ostream& output, std:
 			}
 			handler.disconnectStreams();
 			binmode = handler.binary_mode;
+			if (handler.mux_mode) {
+				handler.dispatchMux(input, output, error, inited);
+				break;
+			}
 			int i = input.get();
 			while (i != EOF && isspace(i)) i = input.get();
 			if (i == EOF) break;
@@ -432,6 +513,152 @@ void AbstractBrokerAPI::dispatch(std::istream& input, std::ostream& output, std:
 	handler.logStream = nullptr;
 }
 
+void AbstractBrokerAPI::dispatchMux(std::istream &input, std::ostream &output, std::ostream &error, bool inited) {
+	std::mutex qlock;
+	std::condition_variable qcond;
+	std::queue<Value> queue;
+	bool finish = false;
+
+	auto writeResponse = [&](Value res) {
+		std::lock_guard _(outLock);
+		if (binary_mode) {
+			res.serializeBinary([&](char c){output.put(c);}, json::compressKeys);
+		} else {
+			res.toStream(output);
+			output << std::endl;
+		}
+		output.flush();
+	};
+
+	auto worker = [&] {
+		std::unique_lock lk(qlock);
+		while (true) {
+			qcond.wait(lk, [&]{return finish || !queue.empty();});
+			if (queue.empty()) break;
+			Value req = queue.front();
+			queue.pop();
+			lk.unlock();
+			Value res = callMethod(req[1].getString(), req[2]);
+			writeResponse({req[0], res[0], res[1]});
+			lk.lock();
+		}
+	};
+
+	//in this mode, streams are connected all the time, because requests overlap
+	connectStreams(error, output);
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0, cnt = concurrentRequests(); i < cnt; i++) {
+		workers.emplace_back(worker);
+	}
+	try {
+		while (true) {
+			int i = input.get();
+			while (i != EOF && isspace(i)) i = input.get();
+			if (i == EOF) break;
+			input.putback(i);
+			Value v = binary_mode
+					?Value::parseBinary([&]{return input.get();}, json::base64)
+					:Value::fromStream(input);
+			if (!inited) {
+				loadKeys();
+				onInit();
+				inited = true;
+			}
+			std::lock_guard _(qlock);
+			queue.push(v);
+			qcond.notify_one();
+		}
+	} catch (std::exception &e) {
+		//untagged response - fatal error
+		writeResponse({false, e.what()});
+	}
+	{
+		std::lock_guard _(qlock);
+		finish = true;
+		qcond.notify_all();
+	}
+	for (auto &t: workers) t.join();
+	disconnectStreams();
+}
+
+namespace {
+
+///Passes complete lines to the log function of the plugin
+class PluginLogBuf: public std::streambuf {
+public:
+	PluginLogBuf(MMBotPluginWriteFn fn, void *ctx):fn(fn),ctx(ctx) {}
+protected:
+	virtual int overflow(int c) override {
+		if (c == EOF) return 0;
+		if (c == '\n') {
+			fn(ctx, line.data(), line.size());
+			line.clear();
+		} else {
+			line.push_back(static_cast<char>(c));
+		}
+		return c;
+	}
+
+	MMBotPluginWriteFn fn;
+	void *ctx;
+	std::string line;
+};
+
+struct PluginHandle {
+	PluginLogBuf logbuf;
+	std::ostream log;
+	///there is no timeout in the plugin mode, need_more_time() writes nowhere
+	std::ostream out;
+	std::mutex initLock;
+	bool inited = false;
+	std::unique_ptr<AbstractBrokerAPI> broker;
+
+	PluginHandle(AbstractBrokerAPI *broker, MMBotPluginWriteFn logfn, void *ctx)
+		:logbuf(logfn, ctx),log(&logbuf),out(nullptr),broker(broker) {}
+};
+
+}
+
+void *AbstractBrokerAPI::pluginOpen(AbstractBrokerAPI *broker, MMBotPluginWriteFn log, void *ctx) {
+	PluginHandle *h = new PluginHandle(broker, log, ctx);
+	broker->logProvider->setDefault();
+	//requests can overlap, so streams are connected all the time (as in the multiplexed mode)
+	broker->connectStreams(h->log, h->out);
+	return h;
+}
+
+void AbstractBrokerAPI::pluginCall(void *handle, const char *request, std::size_t size, MMBotPluginWriteFn response, void *ctx) {
+	PluginHandle *h = static_cast<PluginHandle *>(handle);
+	Value res;
+	try {
+		const char *end = request+size;
+		Value v = Value::parseBinary([&]{
+			return request < end?static_cast<unsigned char>(*request++):EOF;
+		}, json::base64);
+		auto cmd = v[0].getString();
+		if (cmd != "bin" && cmd != "enableDebug" && cmd != "mux" && cmd != "packed") {
+			std::lock_guard _(h->initLock);
+			if (!h->inited) {
+				h->broker->loadKeys();
+				h->broker->onInit();
+				h->inited = true;
+			}
+		}
+		res = h->broker->callMethod(cmd, v[1]);
+	} catch (std::exception &e) {
+		res = {false, e.what()};
+	}
+	std::string buff;
+	res.serializeBinary([&](char c){buff.push_back(c);}, json::compressKeys);
+	response(ctx, buff.data(), buff.size());
+}
+
+void AbstractBrokerAPI::pluginClose(void *handle) {
+	PluginHandle *h = static_cast<PluginHandle *>(handle);
+	h->broker->disconnectStreams();
+	delete h;
+}
+
 AbstractBrokerAPI::AbstractBrokerAPI(const std::string &secure_storage_path,
 		const Value &apiKeyFormat)
 :secure_storage_path(secure_storage_path)
@@ -530,6 +757,7 @@ json::Value AbstractBrokerAPI::getMarkets() const  {
 }
 
 void AbstractBrokerAPI::need_more_time() {
+	std::lock_guard _(outLock);
 	if (outStream) *outStream << std::endl;
 }
 
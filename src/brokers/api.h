@@ -10,9 +10,11 @@
 
 #include <iostream>
 #include <limits>
+#include <mutex>
 
 #include <imtjson/value.h>
 #include "../main/apikeys.h"
+#include "../main/brokerplugin.h"
 #include "../main/ibrokercontrol.h"
 #include "../main/istockapi.h"
 #include "../main/sgn.h"
@@ -63,6 +65,15 @@ public:
 
 	void dispatch();
 
+	///Creates plugin handle for the broker (ownership of the broker is transfered)
+	/** Used by MMBOT_BROKER_PLUGIN. Broker's log is connected to the log function for
+	 * whole lifetime of the handle */
+	static void *pluginOpen(AbstractBrokerAPI *broker, MMBotPluginWriteFn log, void *ctx);
+	///Processes request of the plugin - same way as the dispatch()
+	static void pluginCall(void *handle, const char *request, std::size_t size, MMBotPluginWriteFn response, void *ctx);
+	///Destroys plugin handle and the broker
+	static void pluginClose(void *handle);
+
 	template<typename T, typename Fn>
 	T mapJSON(json::Value cont, Fn &&fn, T &&tmp = T()) {
 		for (json::Value x: cont) {
@@ -122,6 +133,19 @@ public:
 
 
 	bool binary_mode = false;
+	///historical data are sent as packed block of numbers (see packeddata.h)
+	bool packed_mode = false;
+	///multiplexed mode is active - requests are tagged and processed concurrently
+	bool mux_mode = false;
+
+	///Count of requests which can be processed concurrently
+	/**
+	 * If the function returns more than 1, the broker accepts multiplexed mode. In this
+	 * mode, requests are processed by a thread pool, so all methods must be thread safe.
+	 * Default implementation returns 1 - multiplexed mode is disabled
+	 */
+	virtual unsigned int concurrentRequests() const {return 1;}
+
 	///tests, whether keys are valid
 	///default implementation calls getWallet_direct(), as the feature is not implemented on brokers yet
 	///however, this should be improved later
@@ -138,7 +162,10 @@ protected:
 	std::vector<std::string> logMessages;
 	std::ostream *logStream = nullptr;;
 	std::ostream *outStream = nullptr;;
+	///serializes writes to the output stream (in multiplexed mode)
+	std::mutex outLock;
 	virtual void flushMessages();
+	void dispatchMux(std::istream &input, std::ostream &output, std::ostream &error, bool inited);
 	void connectStreams(std::ostream &log, std::ostream &out);
 	void disconnectStreams();
 
@@ -157,6 +184,23 @@ protected:
 };
 
 
+///Exports the broker as plugin, so it can be loaded into the mmbot process
+/**
+ * @param Type type of the broker, it must be constructible from the secure storage path
+ *
+ * The broker must be built as shared library (see BROKER_PLUGINS). The mmbot loads the plugin, when
+ * the command line of the broker refers to a file with extension .so
+ */
+#define MMBOT_BROKER_PLUGIN(Type) \
+	extern "C" __attribute__((visibility("default"))) void *mmbot_broker_open(const char *secure_storage_path, MMBotPluginWriteFn log, void *ctx) { \
+		return AbstractBrokerAPI::pluginOpen(new Type(secure_storage_path), log, ctx); \
+	} \
+	extern "C" __attribute__((visibility("default"))) void mmbot_broker_call(void *handle, const char *request, std::size_t size, MMBotPluginWriteFn response, void *ctx) { \
+		AbstractBrokerAPI::pluginCall(handle, request, size, response, ctx); \
+	} \
+	extern "C" __attribute__((visibility("default"))) void mmbot_broker_close(void *handle) { \
+		AbstractBrokerAPI::pluginClose(handle); \
+	}
 
 #endif /* SRC_BROKERS_API_H_ */
 
@@ -935,6 +935,8 @@ Interface::BrokerInfo Interface::getBrokerInfo() {
 	};
 }
 
+MMBOT_BROKER_PLUGIN(Interface)
+
 int main(int argc, char **argv) {
 	using namespace json;
 
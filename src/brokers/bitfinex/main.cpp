@@ -10,6 +10,8 @@
 #include "interface.h"
 
 
+MMBOT_BROKER_PLUGIN(Interface)
+
 int main(int argc, char **argv) {
 	using namespace json;
 
@@ -5,6 +5,7 @@
  *      Author: ondra
  */
 
+#include <future>
 #include <imtjson/object.h>
 #include <imtjson/parser.h>
 #include <imtjson/operations.h>
@@ -204,12 +205,12 @@ json::Value ByBitBrokerV5::getApiKeyFields() const {
 void ByBitBrokerV5::onLoadApiKey(json::Value keyData) {
     json::Value api_key_json = keyData["api_key"];
     json::Value priv_key_json = keyData["private_key"];
+    PCredentials cred;
     if (api_key_json.hasValue() && priv_key_json.hasValue()) {
-        cur_api_key = api_key_json.getString();
-        cur_priv_key = string2key(priv_key_json.getString());
-    } else {
-        cur_api_key.clear();
-        cur_priv_key.reset();
+        cred = std::make_shared<Credentials>(Credentials{
+            api_key_json.getString(),
+            string2key(priv_key_json.getString())
+        });
     }
     std::string url;
     if (keyData["server"].getString() == "testnet") {
@@ -219,13 +220,43 @@ void ByBitBrokerV5::onLoadApiKey(json::Value keyData) {
         url = "https://api.bybit.com";
         is_paper = false;
     }
-    httpc = std::make_unique<HTTPJson>(simpleServer::HttpClient(userAgent, simpleServer::newHttpsProvider(), nullptr, simpleServer::newCachedDNSProvider(15)),url);
+    std::lock_guard _(_lock);
+    _cred = std::move(cred);
+    _url = std::move(url);
+    _clients.clear();
 }
 
 void ByBitBrokerV5::onInit() {
-    if (!httpc) {
-        httpc = std::make_unique<HTTPJson>(simpleServer::HttpClient(userAgent, simpleServer::newHttpsProvider(), nullptr, simpleServer::newCachedDNSProvider(15)),"https://api.bybit.com");
+    //clients are created on demand
+}
+
+ByBitBrokerV5::PCredentials ByBitBrokerV5::getCredentials() const {
+    std::lock_guard _(_lock);
+    return _cred;
+}
+
+template<typename Fn>
+auto ByBitBrokerV5::withClient(Fn &&fn) {
+    std::unique_ptr<Client> c;
+    {
+        std::lock_guard _(_lock);
+        if (_clients.empty()) {
+            c.reset(new Client{_url, HTTPJson(simpleServer::HttpClient(userAgent, simpleServer::newHttpsProvider(), nullptr, simpleServer::newCachedDNSProvider(15)),_url)});
+        } else {
+            c = std::move(_clients.back());
+            _clients.pop_back();
+        }
     }
+    //when fn throws, the client is dropped, connection can be in undefined state
+    auto r = fn(c->http);
+    std::lock_guard _(_lock);
+    //don't return client of the old server
+    if (c->url == _url) _clients.push_back(std::move(c));
+    return r;
+}
+
+std::chrono::system_clock::time_point ByBitBrokerV5::serverTime() {
+    return withClient([](HTTPJson &httpc){return httpc.now();});
 }
 
 json::Value ByBitBrokerV5::getMarkets() const {
@@ -236,7 +267,8 @@ json::Value ByBitBrokerV5::getMarkets() const {
     static const std::string_view inversed = "Inversed";
     static const std::string_view perpetual = "Perpetual";
 
-    const SymbolMap &s = const_cast<ByBitBrokerV5 *>(this)->getSymbols();
+    auto sp = const_cast<ByBitBrokerV5 *>(this)->getSymbols();
+    const SymbolMap &s = *sp;
     for (const auto &[id, nfo] : s) {
         switch (nfo.cat) {
             case Category::spot:
@@ -283,7 +315,8 @@ json::Value ByBitBrokerV5::testCall(const std::string_view &method,json::Value a
 
 bool ByBitBrokerV5::areMinuteDataAvailable(const std::string_view &asset,
         const std::string_view &currency) {
-    const auto &s = getSymbols();
+    auto sp = getSymbols();
+    const auto &s = *sp;
     auto iter = std::find_if(s.begin(), s.end(),[&](const auto &x){
             return x.second.currency_symbol == currency && x.second.asset_symbol == asset;
     });
@@ -293,7 +326,8 @@ bool ByBitBrokerV5::areMinuteDataAvailable(const std::string_view &asset,
 std::uint64_t ByBitBrokerV5::downloadMinuteData(const std::string_view &asset,
         const std::string_view &currency, const std::string_view &hint_pair,
         std::uint64_t time_from, std::uint64_t time_to, HistData &xdata) {
-    const auto &s = getSymbols();
+    auto sp = getSymbols();
+    const auto &s = *sp;
     auto iter = s.find(hint_pair);
     if (iter == s.end()) {
         iter = std::find_if(s.begin(), s.end(),[&](const auto &x){
@@ -368,7 +402,7 @@ bool ByBitBrokerV5::reset() {
 IStockApi::TradesSync ByBitBrokerV5::syncTrades(json::Value lastId,
         const std::string_view &pair) {
     const auto &s = getSymbol(pair);
-    auto now = httpc->now();
+    auto now = serverTime();
     auto endTime = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count()-5000;
     auto startTime = lastId.getIntLong();
     static constexpr std::int64_t max_window = 600000000LL; //6 days and 23 hours
@@ -498,7 +532,8 @@ json::Value ByBitBrokerV5::placeOrder(const std::string_view &pair, double size,
 
 std::vector<std::string> ByBitBrokerV5::getAllPairs() {
     std::vector<std::string> out;
-    const auto &s = getSymbols();
+    auto sp = getSymbols();
+    const auto &s = *sp;
     for (const auto &[key, value]: s) {
         out.push_back(key);
     }
@@ -516,7 +551,7 @@ IStockApi::Ticker ByBitBrokerV5::getTicker(const std::string_view &pair) {
         t["bid1Price"].getNumber(),
         t["ask1Price"].getNumber(),
         t["lastPrice"].getNumber(),
-        static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(httpc->now().time_since_epoch()).count())
+        static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(serverTime().time_since_epoch()).count())
     };
     if (s.invert_price) {
         double z = ticker.ask;
@@ -626,18 +661,48 @@ double ByBitBrokerV5::getBalance(const std::string_view &symb, const std::string
     return 0;
 }
 
+IStockApi::Snapshot ByBitBrokerV5::getSnapshot(const std::string_view &pair,
+        const std::string_view &asset, const std::string_view &currency,
+        json::Value lastId) {
+    const auto &s = getSymbol(pair);
+    //requests are independent, every request uses own connection
+    auto orders = std::async(std::launch::async, [&]{return getOpenOrders(pair);});
+    auto trades = std::async(std::launch::async, [&]{return syncTrades(lastId, pair);});
+    auto ticker = std::async(std::launch::async, [&]{return getTicker(pair);});
+    Snapshot res;
+    if (s.cat == Category::spot) {
+        //both balances are returned by single request
+        json::Value v = privateGET("/v5/account/wallet-balance",json::Object{
+            {"accountType",getAccountType() == AccountType::regular?"SPOT":"UNIFIED"},
+            {"coin",std::string(asset).append(",").append(currency)}
+        });
+        res.assetBalance = 0;
+        res.currencyBalance = 0;
+        for (json::Value c: v["list"][0]["coin"]) {
+            auto coin = c["coin"].getString();
+            if (coin == asset) res.assetBalance = c["equity"].getNumber();
+            else if (coin == currency) res.currencyBalance = c["equity"].getNumber();
+        }
+    } else {
+        auto asset_balance = std::async(std::launch::async, [&]{return getBalance(asset, pair);});
+        res.currencyBalance = getBalance(currency, pair);
+        res.assetBalance = asset_balance.get();
+    }
+    res.orders = orders.get();
+    res.trades = trades.get();
+    res.ticker = ticker.get();
+    return res;
+}
+
 double ByBitBrokerV5::getFees(const std::string_view &char_traits) {
     return 0.001;
 }
 
 bool ByBitBrokerV5::has_keys() const {
-    if (cur_priv_key != nullptr) return true;
-    static bool preinit = false;
-    if (!preinit) {
-        //preinitalize openssl to avoid long delay when creating api key
-        generateKeysWithBits(2048);
-        preinit = true;
-    }
+    if (getCredentials() != nullptr) return true;
+    //preinitalize openssl to avoid long delay when creating api key
+    static const bool preinit = (generateKeysWithBits(2048), true);
+    (void)preinit;
     return false;
 }
 
@@ -663,9 +728,21 @@ json::Value handleResponse(json::Value resp) {
     throw std::runtime_error(std::to_string(code).append(" ").append(resp["retMsg"].getString()));
 }
 
-const ByBitBrokerV5::SymbolMap& ByBitBrokerV5::getSymbols() {
+ByBitBrokerV5::PSymbolMap ByBitBrokerV5::getSymbols() {
     auto now = std::chrono::system_clock::now();
-    if (_symbol_map_expire < now) {
+    {
+        std::lock_guard _(_lock);
+        if (_symbol_map && _symbol_map_expire >= now) return _symbol_map;
+    }
+    std::lock_guard _(_symbol_lock);
+    PSymbolMap cur;
+    {
+        std::lock_guard _(_lock);
+        cur = _symbol_map;
+        //other thread already downloaded symbols
+        if (cur && _symbol_map_expire >= now) return cur;
+    }
+    {
         json::Value args = json::Object{
             {"limit", 1000},
             {"category", "spot"}
@@ -742,11 +819,13 @@ const ByBitBrokerV5::SymbolMap& ByBitBrokerV5::getSymbols() {
             minfo.simulator = is_paper;
             map.emplace(std::move(name), std::move(minfo));
         }
-        _symbol_map = std::move(map);
+        cur = std::make_shared<const SymbolMap>(std::move(map));
+        std::lock_guard _(_lock);
+        _symbol_map = cur;
         _symbol_map_expire = now + std::chrono::minutes(15);
 
     }
-    return _symbol_map;
+    return cur;
 }
 
 std::string_view create_query(std::string &path, json::Value query) {
@@ -769,7 +848,9 @@ std::string_view create_query(std::string &path, json::Value query) {
 json::Value ByBitBrokerV5::publicGET(std::string path, json::Value query) {
     create_query(path, query);
     try {
-        return handleResponse(httpc->GET(path,json::Value()));
+        return handleResponse(withClient([&](HTTPJson &httpc){
+            return httpc.GET(path,json::Value());
+        }));
     } catch (HTTPJson::UnknownStatusException &e) {
         handleError(e);
         throw;
@@ -777,11 +858,13 @@ json::Value ByBitBrokerV5::publicGET(std::string path, json::Value query) {
 }
 
 json::Value ByBitBrokerV5::privateGET(std::string path, json::Value query) {
-    if (cur_priv_key == nullptr) throw std::runtime_error("This call needs valid API key");
+    auto cred = getCredentials();
+    if (cred == nullptr) throw std::runtime_error("This call needs valid API key");
     auto pp = create_query(path, query);
-    auto hdrs = genSignature(httpc->now(), pp, cur_api_key, cur_priv_key);
     try {
-        return handleResponse(httpc->GET(path,std::move(hdrs)));
+        return handleResponse(withClient([&](HTTPJson &httpc){
+            return httpc.GET(path,genSignature(httpc.now(), pp, cred->api_key, cred->priv_key));
+        }));
     } catch (HTTPJson::UnknownStatusException &e) {
         handleError(e);
         throw;
@@ -789,19 +872,22 @@ json::Value ByBitBrokerV5::privateGET(std::string path, json::Value query) {
 }
 
 json::Value ByBitBrokerV5::privatePOST(std::string path, json::Value payload) {
-    if (cur_priv_key == nullptr) throw std::runtime_error("This call needs valid API key");
+    auto cred = getCredentials();
+    if (cred == nullptr) throw std::runtime_error("This call needs valid API key");
     auto s = payload.stringify();
-    auto hdrs = genSignature(httpc->now(), s.str() , cur_api_key, cur_priv_key);
     try {
-        return handleResponse(httpc->POST(path,payload, std::move(hdrs)));
+        return handleResponse(withClient([&](HTTPJson &httpc){
+            return httpc.POST(path,payload, genSignature(httpc.now(), s.str() , cred->api_key, cred->priv_key));
+        }));
     } catch (HTTPJson::UnknownStatusException &e) {
         handleError(e);
         throw;
     }
 }
 
-const ByBitBrokerV5::MarketInfoEx &ByBitBrokerV5::getSymbol(std::string_view symbol) {
-    const auto &s = getSymbols();
+ByBitBrokerV5::MarketInfoEx ByBitBrokerV5::getSymbol(std::string_view symbol) {
+    auto sp = getSymbols();
+    const auto &s = *sp;
     auto iter = s.find(symbol);
     if (iter == s.end()) throw std::runtime_error("Unknown symbol");
     return iter->second;
@@ -835,7 +921,7 @@ json::Value ByBitBrokerV5::parseLinkId(json::Value linkId) {
 }
 
 json::Value ByBitBrokerV5::createLinkId(json::Value tag) {
-    static auto now_clk = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    static std::atomic<std::int64_t> now_clk = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     auto id = ++now_clk;
     std::basic_string<unsigned char> binOut;
     json::Value data = {tag.stripKey(), id};
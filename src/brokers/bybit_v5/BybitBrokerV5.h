@@ -12,7 +12,9 @@
 #include "../httpjson.h"
 
 #include "rsa_tools.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <optional>
 class ByBitBrokerV5: public AbstractBrokerAPI {
 public:
@@ -49,6 +51,12 @@ public:
     virtual IStockApi::MarketInfo getMarketInfo(const std::string_view &pair)override;
     virtual double getBalance(const std::string_view &symb, const std::string_view &pair) override;
     virtual double getFees(const std::string_view&) override;
+    virtual Snapshot getSnapshot(const std::string_view & pair,
+            const std::string_view & asset,
+            const std::string_view & currency,
+            json::Value lastId) override;
+    ///Requests are processed concurrently in the multiplexed mode
+    virtual unsigned int concurrentRequests() const override {return 4;}
 
 
 protected:
@@ -59,12 +67,32 @@ protected:
         unified_trade = 3
     };
 
-    std::unique_ptr<HTTPJson> httpc;
-    bool is_paper = false;
-    AccountType unified_mode = AccountType::unknown;
+    struct Credentials {
+        std::string api_key;
+        PEVP_PKEY priv_key;
+    };
+
+    using PCredentials = std::shared_ptr<const Credentials>;
 
-    std::string cur_api_key;
-    PEVP_PKEY cur_priv_key;
+    struct Client {
+        std::string url;
+        HTTPJson http;
+    };
+
+    ///Protects credentials, symbol map and pool of clients
+    /** Methods can be called from multiple threads (multiplexed mode), every request
+     * borrows own http client from the pool */
+    mutable std::mutex _lock;
+    std::vector<std::unique_ptr<Client> > _clients;
+    std::string _url = "https://api.bybit.com";
+    PCredentials _cred;
+    std::atomic<bool> is_paper = false;
+    std::atomic<AccountType> unified_mode = AccountType::unknown;
+
+    PCredentials getCredentials() const;
+    ///Borrows http client from the pool, function receives HTTPJson &
+    template<typename Fn> auto withClient(Fn &&fn);
+    std::chrono::system_clock::time_point serverTime();
 
     bool has_keys() const;
 
@@ -82,12 +110,16 @@ protected:
 
     using SymbolMap = std::map<std::string, MarketInfoEx, std::less<>>;
 
-    SymbolMap _symbol_map;
+    using PSymbolMap = std::shared_ptr<const SymbolMap>;
+
+    PSymbolMap _symbol_map;
     std::chrono::system_clock::time_point _symbol_map_expire;
+    ///Serializes download of the symbols
+    std::mutex _symbol_lock;
 
 
-    const SymbolMap &getSymbols();
-    const MarketInfoEx &getSymbol(std::string_view symbol);
+    PSymbolMap getSymbols();
+    MarketInfoEx getSymbol(std::string_view symbol);
 
     json::Value publicGET(std::string path, json::Value query);
     json::Value privateGET(std::string path, json::Value query);
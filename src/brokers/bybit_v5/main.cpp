@@ -10,6 +10,8 @@
 #include "BybitBrokerV5.h"
 #include "rsa_tools.h"
 
+MMBOT_BROKER_PLUGIN(ByBitBrokerV5)
+
 int main(int argc, char **argv) {
     using namespace json;
 
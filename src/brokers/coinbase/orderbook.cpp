@@ -1,5 +1,7 @@
 #include "orderbook.h"
 
+#include <algorithm>
+#include <cmath>
 #include <shared/logOutput.h>
 
 using ondra_shared::logDebug;
@@ -40,14 +42,20 @@ std::optional<IStockApi::Ticker> OrderBook::getTicker(std::string_view product)
     if (iter->second._wait.has_value()) return {};
     OrderBookItem &o = iter->second;
     if (o._buy.empty() || o._sell.empty()) return {};
-    double bid = o._buy.rbegin()->first;
-    double ask = o._sell.begin()->first;
+    double bid = o._buy.best();
+    double ask = o._sell.best();
     double mid = std::sqrt(bid*ask);
     std::uint64_t tm = std::chrono::duration_cast<std::chrono::milliseconds>(
             o._last_update.time_since_epoch()
     ).count();
-    logDebug("getTicker-stats: SYMBOL=$1, LEVELS=$2, UPDATES=$3", product, o._buy.size()+o._sell.size(), o._updates);
-    o._expires = std::chrono::system_clock::now()+std::chrono::seconds(collect_timeout_sec);
+    auto now = std::chrono::system_clock::now();
+    double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - o._stats_time).count()*0.001;
+    double rate = elapsed > 0?(o._level_updates - o._stats_updates)/elapsed:0;
+    logDebug("getTicker-stats: SYMBOL=$1, LEVELS=$2, UPDATES=$3, LEVEL_UPDATES=$4, RATE=$5/s, MEMORY=$6",
+            product, o._buy.size()+o._sell.size(), o._updates, o._level_updates, rate, o._buy.memory()+o._sell.memory());
+    o._stats_time = now;
+    o._stats_updates = o._level_updates;
+    o._expires = now+std::chrono::seconds(collect_timeout_sec);
     return IStockApi::Ticker {bid,ask,mid,tm};
 }
 
@@ -87,14 +95,16 @@ std::string_view OrderBook::process_data(json::Value data) {
             o._buy.clear();
             o._sell.clear();
         }
+        _bid_updates.clear();
+        _ask_updates.clear();
         for (json::Value v: event["updates"]) {
-            auto &side = v["side"].getString()=="bid"?o._buy:o._sell;
-            double q = v["new_quantity"].getNumber();
-            double p = v["price_level"].getNumber();
-            if (q == 0) side.erase(p);
-            else side[p] = q;
+            auto &side = v["side"].getString()=="bid"?_bid_updates:_ask_updates;
+            side.push_back({v["price_level"].getNumber(), v["new_quantity"].getNumber()});
         }
+        o._buy.apply(_bid_updates);
+        o._sell.apply(_ask_updates);
         ++o._updates;
+        o._level_updates += _bid_updates.size() + _ask_updates.size();
         if (o._wait.has_value()) {
             o._wait->set_value(true);
             o._wait.reset();
@@ -105,6 +115,40 @@ std::string_view OrderBook::process_data(json::Value data) {
   return unsub;
 }
 
+void OrderBook::BookSide::apply(std::vector<Level> &updates) {
+    auto cmp = [&](const Level &a, const Level &b) {return worse(a.price, b.price);};
+    if (updates.size() < merge_threshold) {
+        for (const Level &l: updates) {
+            auto iter = std::lower_bound(_levels.begin(), _levels.end(), l, cmp);
+            if (iter != _levels.end() && iter->price == l.price) {
+                if (l.qty == 0) _levels.erase(iter);
+                else iter->qty = l.qty;
+            } else if (l.qty != 0) {
+                _levels.insert(iter, l);
+            }
+        }
+    } else {
+        //stable sort - the last update of the same price wins
+        std::stable_sort(updates.begin(), updates.end(), cmp);
+        _tmp.clear();
+        _tmp.reserve(_levels.size()+updates.size());
+        auto a = _levels.begin(), ae = _levels.end();
+        auto b = updates.begin(), be = updates.end();
+        while (a != ae || b != be) {
+            if (b == be || (a != ae && cmp(*a, *b))) {
+                _tmp.push_back(*a);
+                ++a;
+                continue;
+            }
+            auto u = b;
+            while (++b != be && b->price == u->price) u = b;
+            if (a != ae && a->price == u->price) ++a;
+            if (u->qty != 0) _tmp.push_back(*u);
+        }
+        std::swap(_levels, _tmp);
+    }
+}
+
 bool OrderBook::any_product() const {
     return !_orderBooks.empty();
 }
@@ -122,7 +166,8 @@ std::future<bool> OrderBook::init_product(std::string_view name) {
     }
     OrderBookItem &item = _orderBooks[std::string(name)];
     item._wait.emplace();
-    item._expires = std::chrono::system_clock::now()+std::chrono::seconds(collect_timeout_sec);
+    item._stats_time = std::chrono::system_clock::now();
+    item._expires = item._stats_time+std::chrono::seconds(collect_timeout_sec);
     return item._wait->get_future();
 }
 
@@ -16,6 +16,7 @@
 #include <map>
 #include <optional>
 #include <variant>
+#include <vector>
 
 class OrderBook {
 public:
@@ -37,17 +38,56 @@ public:
     static constexpr int collect_timeout_sec = 150;
     
 protected:
-    
+
+    struct Level {
+        double price;
+        double qty;
+    };
+
+    ///One side of the order book
+    /**
+     * Levels are stored in a flat array sorted from the worst price to the best price. The
+     * best price is at the end, so it is available in O(1) and updates near the top of the book
+     * move only few items
+     */
+    class BookSide {
+    public:
+        ///Count of updates, when it is faster to merge them than to apply them one by one
+        static constexpr std::size_t merge_threshold = 32;
+
+        BookSide(bool bid):_bid(bid) {}
+        void clear() {_levels.clear();}
+        bool empty() const {return _levels.empty();}
+        std::size_t size() const {return _levels.size();}
+        ///Best price (side must not be empty)
+        double best() const {return _levels.back().price;}
+        ///Memory allocated by the side in bytes
+        std::size_t memory() const {return (_levels.capacity()+_tmp.capacity())*sizeof(Level);}
+        ///Apply batch of updates. Zero quantity removes the level. Updates are reordered
+        void apply(std::vector<Level> &updates);
+    protected:
+        bool _bid;
+        std::vector<Level> _levels;
+        std::vector<Level> _tmp;
+        bool worse(double a, double b) const {return _bid?a<b:a>b;}
+    };
+
     struct OrderBookItem {
-        std::map<double, double> _buy, _sell;
+        BookSide _buy = BookSide(true);
+        BookSide _sell = BookSide(false);
         std::optional<std::promise<bool> > _wait;
         std::chrono::system_clock::time_point _expires;
         std::chrono::system_clock::time_point _last_update;
         std::size_t _updates = 0;
-        
+        std::size_t _level_updates = 0;
+        ///time and count of updates at last report of the stats
+        std::chrono::system_clock::time_point _stats_time;
+        std::size_t _stats_updates = 0;
+
     };
     
     std::map<std::string, OrderBookItem,std::less<> > _orderBooks;
+    std::vector<Level> _bid_updates, _ask_updates;
 
     
     std::string_view  process_data(json::Value data);
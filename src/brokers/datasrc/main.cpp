@@ -12,6 +12,7 @@
 #include <simpleServer/http_client.h>
 #include <imtjson/string.h>
 #include "../httpjson.h"
+#include "../../main/packeddata.h"
 #include "shared/stringview.h"
 
 using json::String;
@@ -28,7 +29,7 @@ String transformString(std::string_view str, int (*fn)(int)) {
 	});
 }
 
-Value readPrices(const std::string_view &asset, const std::string_view &currency, std::uint64_t fromTime) {
+Value readPrices(const std::string_view &asset, const std::string_view &currency, std::uint64_t fromTime, bool packed) {
 	std::ostringstream url;
 
 	httpc.set_reading_fn([next_tm = std::chrono::system_clock::now()]()mutable{
@@ -46,7 +47,15 @@ Value readPrices(const std::string_view &asset, const std::string_view &currency
 			<< "&currency=" << simpleServer::urlEncode(currency)
 			<< "&from=" << fromTime;
 
-	return httpc.GET(url.str()).map([&](Value v){return v[1];});
+	Value data = httpc.GET(url.str());
+	if (packed) {
+		std::vector<double> prices;
+		prices.reserve(data.size());
+		for (Value v: data) prices.push_back(v[1].getNumber());
+		return packData(prices);
+	} else {
+		return data.map([&](Value v){return v[1];});
+	}
 
 }
 
@@ -75,7 +84,8 @@ int main(int argc, char **argv) {
 				String currency = transformString(args["currency"].getString(), &std::tolower);
 				auto fromTime = args["from"].getUIntLong();
 
-				Value data = readPrices(asset, currency, fromTime);
+				//client which understands packed data (see packeddata.h) asks for it
+				Value data = readPrices(asset, currency, fromTime, args["packed"].getBool());
 				out = {true, data};
 			} catch (std::exception &e) {
 				out = {false, e.what()};
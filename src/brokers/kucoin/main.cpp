@@ -10,6 +10,8 @@
 #include "kucoin.h"
 
 
+MMBOT_BROKER_PLUGIN(KucoinIFC)
+
 int main(int argc, char **argv) {
 	using namespace json;
 
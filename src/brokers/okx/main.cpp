@@ -10,6 +10,8 @@
 #include "../okx/interface.h"
 
 
+MMBOT_BROKER_PLUGIN(okx::Interface)
+
 int main(int argc, char **argv) {
 	using namespace json;
 
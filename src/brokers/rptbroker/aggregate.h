@@ -19,6 +19,16 @@ public:
 	using Map = std::map<Key, std::optional<Value>, KeyCompare>;
 
 	void invalidate(const Key &k);
+	///Updates cached value in place
+	/**
+	 * @param k key
+	 * @param fn function which receives reference to the value. Missing value is
+	 * created empty. Invalidated value is not changed, it is reduced on next access
+	 */
+	template<typename Fn> void modify(const Key &k, Fn &&fn);
+	///Sets value directly (for example loaded from cache)
+	void assign(const Key &k, std::optional<Value> &&v) {map[k] = std::move(v);}
+	void clear() {map.clear();}
 	const Value &get(const Key &k);
 	const Value &update(typename Map::iterator iter);
 	const Value &update(typename Map::const_iterator iter);
@@ -49,6 +59,16 @@ void AbstractAggregate<Key, Value, KeyCompare>::invalidate(const Key &k) {
 	map[k] = std::optional<Value>();
 }
 
+template<typename Key, typename Value, typename KeyCompare>
+template<typename Fn>
+void AbstractAggregate<Key, Value, KeyCompare>::modify(const Key &k, Fn &&fn) {
+	auto iter = map.find(k);
+	if (iter == map.end()) {
+		iter = map.emplace(k, Value()).first;
+	}
+	if (iter->second.has_value()) fn(*iter->second);
+}
+
 template<typename Key, typename Value, typename KeyCompare>
 const Value &AbstractAggregate<Key, Value, KeyCompare>::get(const Key &k) {
 	auto iter = map.find(k);
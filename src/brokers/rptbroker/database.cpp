@@ -12,51 +12,387 @@
 #include "database.h"
 
 #include <algorithm>
+#include <iterator>
+#include <cstring>
 #include <vector>
 extern "C" {
 #include <errno.h>
 #include <sys/file.h>  // for flock()
-}
+#include <sys/stat.h>
+}
+
+static const char indexMagic[8] = {'R','P','T','I','D','X','0','1'};
+
+struct DataBase::IndexHeader {
+	char magic[8];
+	///size of the database covered by the snapshot
+	std::uint64_t data_size;
+	///checksum of the last record covered by the snapshot
+	std::uint64_t last_checksum;
+	std::uint64_t records;
+	std::uint64_t last_timestamp;
+	std::uint64_t unsorted_timestamp;
+	std::uint64_t days;
+	std::uint64_t traders;
+};
+
+struct DataBase::IndexDay {
+	Day day;
+	std::int64_t pos;
+};
+
+///Trader followed by positions of its trades
+struct DataBase::IndexTrader {
+	std::uint64_t uid;
+	std::uint64_t magic;
+	TraderInfoExt info;
+	std::uint64_t trades;
+};
+
+///Journal record - appended for every record added to the database
+struct DataBase::IndexJournal {
+	struct TradeStats {
+		double change;
+		double rpnl;
+		double volume;
+	};
+	Header hdr;
+	///position of the record
+	std::uint64_t pos;
+	///size of the database after the record has been written
+	std::uint64_t end;
+	///checksum of the record
+	std::uint64_t checksum;
+	union {
+		TradeStats trade;
+		TraderInfo tinfo;
+	};
+};
 
 
 DataBase::DataBase(const std::string &fname)
-:fname(fname) {
+:fname(fname),idxname(fname+".idx") {
 	fd = ::open(fname.c_str(), O_RDWR| O_CREAT|O_CLOEXEC, 0666);
 	if (fd<0) throw std::system_error(errno, std::system_category());
 	last_timestamp = 0;
 	unsorted_timestamp = -1;
+	fend = 0;
 }
 
 DataBase::~DataBase() {
+	if (idxfd >= 0) {
+		//compact journal - index is not critical, it is rebuilt on error
+		try {
+			saveIndex();
+		} catch (...) {
+		}
+		::close(idxfd);
+	}
+	unmapFile();
 	::close(fd);
 }
 
+void DataBase::checkOrder(std::uint64_t hdr_time) {
+	if ( hdr_time < last_timestamp) {
+		unsorted_timestamp = std::min(unsorted_timestamp, hdr_time);
+	} else {
+		last_timestamp = hdr_time;
+	}
+}
+
+void DataBase::indexTrade(off_t pos, const Header &hdr, double change, double rpnl, double volume) {
+	auto hdr_time = hdr.getTime();
+	TraderInfoExt *tnfo = findTrader(hdr);
+	if (tnfo == nullptr) throw std::runtime_error("Build index failed: Database is corrupted");
+	tnfo->update(hdr_time, change, rpnl, volume);
+	dayMap.emplace(Day::fromTime(hdr_time), pos); //will not overwrite existing record
+	postingMap[TraderKey{hdr.uid, hdr.magic}].push_back(pos);
+	records++;
+}
+
 void DataBase::buildIndex() {
 	records = 0;
-	Day last{0,0,0};
 	last_timestamp = 0;
 	unsorted_timestamp = -1;
 	dayMap.clear();
+	traderMap.clear();
+	postingMap.clear();
 	scanTradesFrom(0, [&](off_t pos, const Header &hdr, const Trade &trd){
-		auto hdr_time = hdr.getTime();
-		if ( hdr_time < last_timestamp) {
-			unsorted_timestamp = std::min(unsorted_timestamp, hdr_time);
-		} else {
-			last_timestamp = hdr_time;
-		}
-		TraderInfoExt *tnfo = findTrader(hdr);
-		if (tnfo == nullptr) throw std::runtime_error("Build index failed: Database is corrupted");
-		tnfo->update(hdr_time,  trd.change, trd.rpnl, trd.getVolume());
-		Day d = Day::fromTime(hdr_time);
-		if (d != last) {
-			last = d;
-			dayMap.emplace(d, pos);
-		}
-		records++;
+		checkOrder(hdr.getTime());
+		indexTrade(pos, hdr, trd.change, trd.rpnl, trd.getVolume());
 		return true;
 	});
 	fend = getPos();
+	saveIndex();
+}
+
+void DataBase::openIndex() {
+	if (!loadIndex()) buildIndex();
+}
+
+bool DataBase::loadIndex() {
+	std::ifstream f(idxname, std::ios::in|std::ios::binary);
+	if (!f) return false;
+	auto rd = [&](auto &x) {
+		return !!f.read(reinterpret_cast<char *>(&x), sizeof(x));
+	};
+	IndexHeader h;
+	if (!rd(h) || std::memcmp(h.magic, indexMagic, sizeof(indexMagic)) != 0) return false;
+	off_t fsize = setPos(0, SEEK_END);
+	//snapshot must match beginning of the database
+	if (static_cast<off_t>(h.data_size) > fsize) return false;
+	if (h.data_size && readChecksum(h.data_size) != h.last_checksum) return false;
+
+	DayMap days;
+	TraderMap traders;
+	PostingMap postings;
+	for (std::uint64_t i = 0; i < h.days; i++) {
+		IndexDay d;
+		if (!rd(d)) return false;
+		days.emplace(d.day, d.pos);
+	}
+	for (std::uint64_t i = 0; i < h.traders; i++) {
+		IndexTrader t;
+		if (!rd(t)) return false;
+		TraderKey key(t.uid, t.magic);
+		traders.emplace(key, t.info);
+		if (t.trades) {
+			auto &lst = postings[key];
+			lst.resize(t.trades);
+			if (!f.read(reinterpret_cast<char *>(lst.data()), lst.size()*sizeof(off_t))) return false;
+		}
+	}
+	dayMap = std::move(days);
+	traderMap = std::move(traders);
+	postingMap = std::move(postings);
+	records = h.records;
+	last_timestamp = h.last_timestamp;
+	unsorted_timestamp = h.unsorted_timestamp;
+	fend = h.data_size;
+
+	try {
+		//replay journal until it matches the database
+		IndexJournal j;
+		while (rd(j)) {
+			if (static_cast<off_t>(j.pos) != fend || static_cast<off_t>(j.end) > fsize
+					|| readChecksum(j.end) != j.checksum) break;
+			if (j.hdr.type == recTraderInfo) {
+				traderMap.emplace(TraderKey{j.hdr.uid, j.hdr.magic}, j.tinfo);
+			} else if (j.hdr.type == recTrade) {
+				checkOrder(j.hdr.getTime());
+				indexTrade(j.pos, j.hdr, j.trade.change, j.trade.rpnl, j.trade.volume);
+			} else {
+				break;
+			}
+			fend = j.end;
+		}
+	} catch (...) {
+		return false;
+	}
+	bool compact = f.gcount() != 0;
+	//records written after the journal has been stopped (crash)
+	if (fend < fsize) {
+		scanTradesFrom(fend, [&](off_t pos, const Header &hdr, const Trade &trd){
+			checkOrder(hdr.getTime());
+			indexTrade(pos, hdr, trd.change, trd.rpnl, trd.getVolume());
+			return true;
+		});
+		fend = getPos();
+		compact = true;
+	}
+	f.close();
+	if (compact) {
+		saveIndex();
+	} else {
+		idxfd = ::open(idxname.c_str(), O_WRONLY|O_APPEND|O_CLOEXEC);
+	}
+	return true;
+}
+
+void DataBase::saveIndex() {
+	std::string tmpname = idxname+".tmp";
+	{
+		std::ofstream f(tmpname, std::ios::out|std::ios::binary|std::ios::trunc);
+		auto wr = [&](const auto &x) {
+			f.write(reinterpret_cast<const char *>(&x), sizeof(x));
+		};
+		IndexHeader h;
+		std::copy(std::begin(indexMagic), std::end(indexMagic), h.magic);
+		h.data_size = fend;
+		h.last_checksum = fend?readChecksum(fend):0;
+		h.records = records;
+		h.last_timestamp = last_timestamp;
+		h.unsorted_timestamp = unsorted_timestamp;
+		h.days = dayMap.size();
+		h.traders = traderMap.size();
+		wr(h);
+		for (const auto &d: dayMap) {
+			IndexDay x;
+			x.day = d.first;
+			x.pos = d.second;
+			wr(x);
+		}
+		for (const auto &t: traderMap) {
+			auto iter = postingMap.find(t.first);
+			IndexTrader x;
+			x.uid = t.first.first;
+			x.magic = t.first.second;
+			x.info = t.second;
+			x.trades = iter == postingMap.end()?0:iter->second.size();
+			wr(x);
+			if (x.trades) f.write(reinterpret_cast<const char *>(iter->second.data()), iter->second.size()*sizeof(off_t));
+		}
+		if (!f) {
+			::unlink(tmpname.c_str());
+			return;
+		}
+	}
+	if (idxfd >= 0) ::close(idxfd);
+	idxfd = -1;
+	if (::rename(tmpname.c_str(), idxname.c_str())) return;
+	idxfd = ::open(idxname.c_str(), O_WRONLY|O_APPEND|O_CLOEXEC);
+}
+
+void DataBase::dropIndex() {
+	if (idxfd >= 0) ::close(idxfd);
+	idxfd = -1;
+	::unlink(idxname.c_str());
+}
+
+void DataBase::appendJournal(const IndexJournal &j) {
+	if (idxfd < 0) return;
+	if (::write(idxfd, &j, sizeof(j)) != sizeof(j)) {
+		//stop journal, missing records are indexed on next start
+		::close(idxfd);
+		idxfd = -1;
+	}
+}
+
+std::uint64_t DataBase::readChecksum(off_t end) const {
+	std::uint64_t chk = 0;
+	if (end < static_cast<off_t>(sizeof(chk))
+			|| ::pread(fd, &chk, sizeof(chk), end - sizeof(chk)) != sizeof(chk)) return 0;
+	return chk;
+}
 
+const std::vector<off_t> &DataBase::findTrades(const TraderKey &trader) const {
+	static const std::vector<off_t> empty;
+	auto iter = postingMap.find(trader);
+	if (iter == postingMap.end()) return empty;
+	else return iter->second;
+}
+
+bool DataBase::mapFile() {
+	struct stat st;
+	if (::fstat(fd, &st) < 0 || st.st_size == 0) return false;
+	std::size_t sz = st.st_size;
+	if (sz != map_size) {
+		//file has been extended by write(), mapping covers only old size
+		unmapFile();
+		void *p = ::mmap(nullptr, sz, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) return false;
+		map_data = static_cast<const char *>(p);
+		map_size = sz;
+	}
+	return true;
+}
+
+void DataBase::unmapFile() {
+	if (map_data) ::munmap(const_cast<char *>(map_data), map_size);
+	map_data = nullptr;
+	map_size = 0;
+}
+
+void DataBase::advise(off_t from, int advice) const {
+	static const off_t page = ::sysconf(_SC_PAGESIZE);
+	off_t start = std::min<off_t>(from - from % page, map_size);
+	::madvise(const_cast<char *>(map_data) + start, map_size - start, advice);
+}
+
+void DataBase::findVerified(off_t pos, off_t &vbeg, off_t &vend) const {
+	auto iter = verified.upper_bound(pos);
+	if (iter != verified.begin()) {
+		auto prev = std::prev(iter);
+		if (prev->second > pos) {
+			vbeg = prev->first;
+			vend = prev->second;
+			return;
+		}
+	}
+	vbeg = vend = iter == verified.end()?std::numeric_limits<off_t>::max():iter->first;
+}
+
+void DataBase::markVerified(off_t from, off_t to) {
+	if (from >= to) return;
+	auto iter = verified.upper_bound(from);
+	if (iter != verified.begin()) {
+		auto prev = std::prev(iter);
+		if (prev->second >= from) {
+			from = prev->first;
+			to = std::max(to, prev->second);
+			iter = verified.erase(prev);
+		}
+	}
+	while (iter != verified.end() && iter->first <= to) {
+		to = std::max(to, iter->second);
+		iter = verified.erase(iter);
+	}
+	verified.emplace_hint(iter, from, to);
+}
+
+void DataBase::dropVerified(off_t from) {
+	auto iter = verified.lower_bound(from);
+	verified.erase(iter, verified.end());
+	if (!verified.empty()) {
+		auto &last = *verified.rbegin();
+		last.second = std::min(last.second, from);
+	}
+}
+
+bool DataBase::readTrade(off_t pos, Header &hdr, Trade &trade) {
+	if (map_data && pos < static_cast<off_t>(map_size)) {
+		off_t rec = pos, vbeg, vend;
+		findVerified(rec, vbeg, vend);
+		bool verify = rec < vbeg;
+		const Header *h = mapped(pos, hdr);
+		hdr = *h;
+		if (hdr.type == recTrade) {
+			trade = *mapped(pos, trade);
+			mappedChecksum(pos, verify, hdr, trade);
+			if (verify) markVerified(rec, pos);
+			return true;
+		} else if (hdr.type == recOldTrade && hdr.getTime() != 0) {
+			OldTrade old;
+			old = *mapped(pos, old);
+			mappedChecksum(pos, verify, hdr, old);
+			if (verify) markVerified(rec, pos);
+			trade = Trade::fromOld(old);
+			return true;
+		} else {
+			return false;
+		}
+	}
+	off_t cur = getPos();
+	if (pos != cur) {
+		//reuse buffer, when record is near
+		if (pos > cur && pos < cur + static_cast<off_t>(buffer.size())) buffer = buffer.substr(pos - cur);
+		else setPos(pos);
+	}
+	std::uint64_t chksum;
+	if (!read(hdr)) return false;
+	if (hdr.type == recTrade) {
+		if (!read(trade) || !read(chksum)) return false;
+		check_checksum(chksum, hdr, trade);
+		return true;
+	} else if (hdr.type == recOldTrade && hdr.getTime() != 0) {
+		OldTrade old;
+		if (!read(old) || !read(chksum)) return false;
+		check_checksum(chksum, hdr, old);
+		trade = Trade::fromOld(old);
+		return true;
+	} else {
+		return false;
+	}
 }
 
 
@@ -80,12 +416,13 @@ off_t DataBase::findDay(const Day &m) const {
 	return pos;
 }
 
-void DataBase::putTrade(Header hdr, const Trade &trade) {
+std::uint64_t DataBase::putTrade(Header hdr, const Trade &trade) {
 	hdr.type = recTrade;
+	auto chk = checksum(hdr,trade);
 	write(hdr);
 	write(trade);
-	write(checksum(hdr,trade));
-
+	write(chk);
+	return chk;
 }
 
 void DataBase::addTrade(const Header &hdr, const Trade &trade) {
@@ -96,14 +433,17 @@ void DataBase::addTrade(const Header &hdr, const Trade &trade) {
 	} else {
 		last_timestamp = hdr_time;
 	}
-	auto tinfo = findTrader(hdr);
-	if (tinfo == nullptr) throw std::runtime_error("Can't add trade, if trader is not registered");
-	tinfo->update(hdr_time,  trade.change, trade.rpnl,trade.getVolume());
-	fend = setPos(0, SEEK_END);
-	Day d = Day::fromTime(hdr_time);
-	dayMap.emplace(d, fend); //will not overwrite existing record
-	putTrade(hdr, trade);
-	fend = getPos();
+	if (findTrader(hdr) == nullptr) throw std::runtime_error("Can't add trade, if trader is not registered");
+	IndexJournal j;
+	j.hdr = hdr;
+	j.hdr.type = recTrade;
+	j.pos = setPos(0, SEEK_END);
+	j.checksum = putTrade(hdr, trade);
+	j.end = fend = getPos();
+	markVerified(j.pos, fend);
+	j.trade = {trade.change, trade.rpnl, trade.getVolume()};
+	indexTrade(j.pos, hdr, trade.change, trade.rpnl, trade.getVolume());
+	appendJournal(j);
 }
 
 void DataBase::replaceTrade(off_t pos, const Header &hdr, const Trade &trade) {
@@ -165,19 +505,25 @@ bool DataBase::read(T &data) {
 }
 
 void DataBase::addTrader(const Header &hdr, const TraderInfo &trd) {
-	setPos(0,SEEK_END);
-	putTraderInfo(hdr, trd);
-	fend = getPos();
-
-}
-
-void DataBase::putTraderInfo(Header hdr, const TraderInfo &trd) {
+	IndexJournal j;
+	j.hdr = hdr;
+	j.hdr.type = recTraderInfo;
+	j.pos = setPos(0,SEEK_END);
+	j.checksum = putTraderInfo(hdr, trd);
+	j.end = fend = getPos();
+	markVerified(j.pos, fend);
+	j.tinfo = trd;
+	appendJournal(j);
+}
+
+std::uint64_t DataBase::putTraderInfo(Header hdr, const TraderInfo &trd) {
 	hdr.type = recTraderInfo;
+	auto chk = checksum(hdr,trd);
 	write(hdr);
 	write(trd);
-	write(checksum(hdr,trd));
+	write(chk);
 	traderMap[TraderKey{hdr.uid, hdr.magic}] = trd;
-
+	return chk;
 }
 
 
@@ -233,6 +579,13 @@ void DataBase::TraderInfo::setCurrency(const std::string_view &str){
 }
 
 void DataBase::reconstruct( DataBase &db) {
+	dropIndex();
+	unmapFile();
+	verified.clear();
+	traderMap.clear();
+	postingMap.clear();
+	dayMap.clear();
+	records = 0;
 	setPos(0, SEEK_SET);
 	if (ftruncate(fd, 0)<0) throw std::system_error(errno, std::system_category());
 	db.scanTradesFrom(0, [&](off_t, const Header &hdr, const Trade &trd) {
@@ -287,6 +640,7 @@ bool DataBase::sort_unsorted() {
 	std::vector<std::pair<Header, TraderInfo> > traders;
 	std::vector<std::pair<Header, Trade> > trades;
 	auto offs = unsorted_timestamp?findDay(d):0;
+	dropIndex();
 	scanFrom(offs, [&](off_t, const Header &hdr, const Payload &pl){
 		switch (pl.type) {
 		case recOldTrade: trades.emplace_back(hdr, Trade::fromOld(*pl.old_trade)) ;break;
@@ -298,6 +652,8 @@ bool DataBase::sort_unsorted() {
 	std::sort(trades.begin(), trades.end(), [&](const auto &a, const auto &b) {
 		return a.first.getTime() < b.first.getTime();
 	});
+	unmapFile();
+	dropVerified(offs);
 	setPos(offs, SEEK_SET);
 	for (const auto &x: traders) putTraderInfo(x.first, x.second);
 	for (const auto &x: trades)  putTrade(x.first, x.second);
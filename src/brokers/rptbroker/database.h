@@ -9,8 +9,11 @@
 #define SRC_BROKERS_RPTBROKER_DATABASE_H_
 
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <map>
+#include <vector>
+#include <sys/mman.h>
 
 namespace json {
 	class Value;
@@ -124,13 +127,22 @@ public:
 
 	template<typename Fn> void scanFrom(off_t ofs, Fn &&fn);
 	template<typename Fn> void scanTradesFrom(off_t ofs, Fn &&fn);
+	///Reads trades at given positions (must be positions of trade records)
+	template<typename Fn> void scanTradesAt(const std::vector<off_t> &offsets, Fn &&fn);
+	///Loads index from the index file, or builds it, when index file is not valid
+	void openIndex();
+	///Builds index by scanning whole database and stores it to the index file
 	void buildIndex();
 
 	std::size_t size() const {return records;}
 
+	using TraderKey = std::pair<std::uint64_t, std::uint64_t>;
+
 	const TraderInfoExt *findTrader(const Header &hdr) const;
 	TraderInfoExt *findTrader(const Header &hdr);
 	off_t findDay(const Day &m) const;
+	///Retrieves positions of all trades of the trader (ordered)
+	const std::vector<off_t> &findTrades(const TraderKey &trader) const;
 
 
 	void addTrade(const Header &hdr, const Trade &trade);
@@ -147,10 +159,12 @@ public:
 
 	const auto &traders() const {return traderMap;}
 
+	///Identifies content of the database - size and checksum of the last record
+	std::pair<std::uint64_t, std::uint64_t> getState() const {return {fend, readChecksum(fend)};}
+
 	static bool lockFile(const std::string &name);
 
 protected:
-	using TraderKey = std::pair<std::uint64_t, std::uint64_t>;
 	using TraderMap = std::map<TraderKey, TraderInfoExt>;
 
 	mutable TraderMap traderMap;
@@ -158,8 +172,21 @@ protected:
 	using DayMap = std::map<Day, off_t, Day::Cmp>;
 	DayMap dayMap;
 
+	///Positions of trades for every trader
+	using PostingMap = std::map<TraderKey, std::vector<off_t> >;
+	PostingMap postingMap;
+
 	std::string fname;
 	int fd;
+	///Index file - snapshot of the index followed by journal of changes
+	std::string idxname;
+	///Index file opened for appending journal (-1 if not opened)
+	int idxfd = -1;
+
+	struct IndexHeader;
+	struct IndexDay;
+	struct IndexTrader;
+	struct IndexJournal;
 	std::size_t records;
 	std::streamoff fend;
 
@@ -178,13 +205,68 @@ protected:
 
 	template<typename ... Args> static std::uint64_t checksum(const Args & ... args);
 	template<typename ... Args> static void check_checksum(std::uint64_t, const Args & ... args);
-	void putTrade(Header hdr, const Trade &trade);
-	void putTraderInfo(Header hdr, const TraderInfo &trd);
+	std::uint64_t putTrade(Header hdr, const Trade &trade);
+	std::uint64_t putTraderInfo(Header hdr, const TraderInfo &trd);
+	bool readTrade(off_t pos, Header &hdr, Trade &trade);
+
+	///Database file mapped into memory (read only), nullptr if not mapped
+	const char *map_data = nullptr;
+	///Size of the mapped area
+	std::size_t map_size = 0;
+	///Ranges of records already verified (checksum) in this session, begin -> end
+	std::map<off_t, off_t> verified;
+
+	///Maps the file into memory, remaps it when file has been extended
+	/** @retval true mapped
+	 *  @retval false can't be mapped, use read()
+	 */
+	bool mapFile();
+	void unmapFile();
+	///Gives hint to the kernel about access to the mapped area from given offset
+	void advise(off_t from, int advice) const;
+	///Retrieves pointer to the mapped object, advances the position
+	/**
+	 * @param pos position, advanced after the object
+	 * @param tmp temporary object, used when the object is not aligned in the file
+	 * @return pointer to the object
+	 */
+	template<typename T> const T *mapped(off_t &pos, T &tmp) const;
+	///Skips checksum of mapped record, verifies it, when record has not been verified yet
+	template<typename ... Args> void mappedChecksum(off_t &pos, bool verify, const Args & ... args) const;
+	template<typename Fn> void scanMapped(off_t ofs, Fn &&fn);
+	///Finds verified range at given position
+	/**
+	 * @param pos position
+	 * @param vbeg receives begin of the range. If the position is not verified, it receives
+	 *  begin of the next verified range
+	 * @param vend receives end of the range. If the position is not verified, it receives
+	 *  the same value as vbeg
+	 */
+	void findVerified(off_t pos, off_t &vbeg, off_t &vend) const;
+	///Marks range of records as verified, merges adjacent ranges
+	void markVerified(off_t from, off_t to);
+	///Forgets verified ranges from given offset (file has been rewritten)
+	void dropVerified(off_t from);
+
+	bool loadIndex();
+	void saveIndex();
+	void dropIndex();
+	void appendJournal(const IndexJournal &j);
+	///Reads checksum of the record which ends at given position
+	std::uint64_t readChecksum(off_t end) const;
+	///Updates timestamps of the sorting check
+	void checkOrder(std::uint64_t hdr_time);
+	///Adds trade to the index
+	void indexTrade(off_t pos, const Header &hdr, double change, double rpnl, double volume);
 
 };
 
 template<typename Fn>
 inline void DataBase::scanFrom(off_t pos, Fn &&fn)  {
+	if (mapFile()) {
+		scanMapped(pos, std::forward<Fn>(fn));
+		return;
+	}
 	setPos(pos);
 	Header hdr;
 	std::uint64_t chksum;
@@ -228,13 +310,84 @@ inline void DataBase::scanFrom(off_t pos, Fn &&fn)  {
 
 }
 
+template<typename T>
+inline const T *DataBase::mapped(off_t &pos, T &tmp) const {
+	if (pos + static_cast<off_t>(sizeof(T)) > static_cast<off_t>(map_size)) throw std::runtime_error( "Unexpected end of file");
+	const char *p = map_data + pos;
+	pos += sizeof(T);
+	if (reinterpret_cast<std::uintptr_t>(p) % alignof(T) == 0) return reinterpret_cast<const T *>(p);
+	std::memcpy(&tmp, p, sizeof(T));
+	return &tmp;
+}
+
+template<typename ... Args>
+inline void DataBase::mappedChecksum(off_t &pos, bool verify, const Args & ... args) const {
+	std::uint64_t tmp;
+	const std::uint64_t *chksum = mapped(pos, tmp);
+	if (verify) check_checksum(*chksum, args...);
+}
+
+template<typename Fn>
+inline void DataBase::scanMapped(off_t pos, Fn &&fn)  {
+	advise(pos, MADV_SEQUENTIAL);
+	off_t end = map_size;
+	Header hdr_tmp;
+	TraderInfo nfo_tmp;
+	OldTrade old_tmp;
+	Trade trd_tmp;
+	Payload p;
+	bool cont = true;
+	//checksums are verified once per session, newly verified records are collected
+	//to a run, which is marked as verified, when it is interrupted
+	off_t vbeg = 0, vend = 0, run_beg = -1, run_end = -1;
+	while (cont && pos < end) {
+		off_t rec = pos;
+		if (rec >= vend) findVerified(rec, vbeg, vend);
+		bool verify = rec < vbeg;
+		if (!verify && run_beg >= 0) {
+			markVerified(run_beg, run_end);
+			run_beg = -1;
+		}
+		const Header *hdr = mapped(pos, hdr_tmp);
+		switch(hdr->type) {
+		case recOldTrade:
+			unsorted_timestamp = 0;
+			if (hdr->getTime() == 0) {//legacy
+				p.type = recTraderInfo;p.tinfo = mapped(pos, nfo_tmp);
+				mappedChecksum(pos, verify, *hdr, *p.tinfo);
+			} else {
+				p.type = recOldTrade;p.old_trade = mapped(pos, old_tmp);
+				mappedChecksum(pos, verify, *hdr, *p.old_trade);
+			}
+			break;
+		case recTraderInfo:
+			p.type = recTraderInfo;p.tinfo = mapped(pos, nfo_tmp);
+			mappedChecksum(pos, verify, *hdr, *p.tinfo);
+			break;
+		case recTrade:
+			p.type = recTrade;p.trade = mapped(pos, trd_tmp);
+			mappedChecksum(pos, verify, *hdr, *p.trade);
+			break;
+		default: throw std::runtime_error("Database corrupted, unsupported record");
+		};
+		if (verify) {
+			if (run_beg < 0) run_beg = rec;
+			run_end = pos;
+		}
+		cont = fn(rec, *hdr, p);
+	}
+	if (run_beg >= 0) markVerified(run_beg, run_end);
+	//keep file position as the read() path does
+	setPos(pos);
+}
 
 template<typename Fn>
 inline void DataBase::scanTradesFrom(off_t ofs, Fn &&fn)  {
 	scanFrom(ofs, [&](off_t ofs, const Header &hdr, const Payload &payload){
 		switch (payload.type) {
 		case recTraderInfo:
-			traderMap[{hdr.uid,hdr.magic}] = *payload.tinfo;
+			//don't reset statistics of already known trader
+			traderMap.emplace(TraderKey{hdr.uid,hdr.magic}, *payload.tinfo);
 			return true;
 		case recOldTrade:
 			return fn(ofs, hdr, Trade::fromOld(*payload.old_trade));
@@ -248,5 +401,15 @@ inline void DataBase::scanTradesFrom(off_t ofs, Fn &&fn)  {
 }
 
 
+template<typename Fn>
+inline void DataBase::scanTradesAt(const std::vector<off_t> &offsets, Fn &&fn) {
+	if (mapFile()) advise(0, MADV_NORMAL);
+	Header hdr;
+	Trade trd;
+	for (off_t pos: offsets) {
+		if (!readTrade(pos, hdr, trd)) throw std::runtime_error("Database index is corrupted");
+		if (!fn(pos, hdr, trd)) break;
+	}
+}
 
 #endif /* SRC_BROKERS_RPTBROKER_DATABASE_H_ */
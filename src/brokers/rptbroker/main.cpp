@@ -63,7 +63,7 @@ void storeTrade(DataBase &main, DataBase &backup, TradeReport &rep, json::Value
 		main.flush();
 		backup.flush();
 	}
-	rep.invalidate(hdr.getTime());
+	rep.addTrade(hdr, tr);
 }
 
 
@@ -291,7 +291,7 @@ json::Value runOptions(TradeReport &rpt) {
 	};
 }
 
-json::Value runSetDeleted(DataBase &main, DataBase &backup, json::Value args) {
+json::Value runSetDeleted(DataBase &main, DataBase &backup, TradeReport &rep, json::Value args) {
 	json::Value ident = args["id"];
 	if (!ident.defined() || ident.type() != json::array || ident.size() != 4) {
 		throw std::runtime_error("Needs 'id' -  the first four numbers of the row returned by 'query'");
@@ -313,10 +313,12 @@ json::Value runSetDeleted(DataBase &main, DataBase &backup, json::Value args) {
 		r = t;
 		return false;
 	});
+	DataBase::Trade old = r;
 	r.deleted = flag.getBool();
 
 	main.replaceTrade(c, hdr, r);
 	main.flush();
+	rep.replaceTrade(hdr, old, r);
 	try {
 		backup.replaceTrade(c, hdr, r);
 	} catch (std::exception &e) {
@@ -375,11 +377,11 @@ int main(int argc, char **argv) {
 
 		DataBase db_main(path_main);
 		try {
-			db_main.buildIndex();
+			db_main.openIndex();
 		} catch (const std::exception &e) {
 			std::cerr << "Main DB - Warning: " << e.what() << std::endl;
 			DataBase db_backup(path_backup);
-			db_backup.buildIndex();
+			db_backup.openIndex();
 			db_main.reconstruct(db_backup);
 			std::cerr << "Main DB - Restored" << std::endl;
 		}
@@ -387,7 +389,7 @@ int main(int argc, char **argv) {
 
 		DataBase db_backup(path_backup);
 		try {
-			db_backup.buildIndex();
+			db_backup.openIndex();
 		} catch (const std::exception &e) {
 			std::cerr << "Backup DB - Warning: " << e.what() << std::endl;
 			db_backup.reconstruct(db_main);
@@ -414,7 +416,7 @@ int main(int argc, char **argv) {
 			return 0;
 		}
 
-		TradeReport rpt(db_main);
+		TradeReport rpt(db_main, path_main+".rpt");
 
  		Value req = readFromStream(std::cin);
 		Value resp;
@@ -451,7 +453,7 @@ int main(int argc, char **argv) {
 				} else if (cmd == "deleted") {
 					json::Value arg = req[1];
 					if (arg.defined()) {
-						resp = {true, runSetDeleted(db_main, db_backup, arg)};
+						resp = {true, runSetDeleted(db_main, db_backup, rpt, arg)};
 					} else {
 						resp = {true, "supported"};
 					}
@@ -7,9 +7,38 @@
 
 #include "trade_report.h"
 
-TradeReport::TradeReport(DataBase &db):db(db),months(*this),days(*this) {
+#include <cstring>
+#include <unistd.h>
+
+static const char cacheMagic[8] = {'R','P','T','A','G','G','0','1'};
+
+namespace {
+
+struct CacheHeader {
+	char magic[8];
+	///state of the database (DataBase::getState())
+	std::uint64_t data_size;
+	std::uint64_t last_checksum;
+	std::uint64_t days;
+	std::uint64_t months;
+};
 
-	reset();
+}
+
+///Count of symbols of invalidated item
+static const std::uint32_t invalidItem = static_cast<std::uint32_t>(-1);
+
+TradeReport::TradeReport(DataBase &db, const std::string &cache_file)
+	:db(db),cache_file(cache_file),months(*this),days(*this) {
+
+	if (!loadCache()) reset();
+}
+
+TradeReport::~TradeReport() {
+	try {
+		saveCache();
+	} catch (...) {
+	}
 }
 
 TradeReport::SymbolMap TradeReport::buildMap(std::streampos from, std::streampos to) const {
@@ -111,6 +140,120 @@ void TradeReport::invalidate(std::uint64_t tm) {
 	months.invalidate(Day{d.year, d.month});
 }
 
+TradeReport::AggrVal TradeReport::tradeValue(const DataBase::Trade &trade) {
+	if (trade.deleted) return AggrVal{};
+	else return AggrVal{trade.rpnl, trade.change};
+}
+
+void TradeReport::addTrade(const DataBase::Header &hdr, const DataBase::Trade &trade) {
+	applyDelta(hdr, tradeValue(trade), !trade.deleted);
+}
+
+void TradeReport::replaceTrade(const DataBase::Header &hdr, const DataBase::Trade &old_trade, const DataBase::Trade &new_trade) {
+	AggrVal a = tradeValue(old_trade);
+	AggrVal b = tradeValue(new_trade);
+	applyDelta(hdr, AggrVal{b.rpnl - a.rpnl, b.eq - a.eq}, !new_trade.deleted);
+}
+
+void TradeReport::applyDelta(const DataBase::Header &hdr, const AggrVal &delta, bool insert) {
+	const DataBase::TraderInfo *tinfo = db.findTrader(hdr);
+	if (!tinfo) return;
+	auto s = storeSymbol(tinfo->getCurrency());
+	auto fn = [&](SymbolMap &smap) {
+		auto iter = smap.find(s);
+		if (iter == smap.end()) {
+			if (insert) smap.emplace(s, delta);
+		} else {
+			iter->second += delta;
+		}
+	};
+	Day d = Day::fromTime(hdr.getTime());
+	days.modify(d, fn);
+	months.modify(d.getMonth(), fn);
+}
+
+bool TradeReport::loadCache() {
+	std::ifstream f(cache_file, std::ios::in|std::ios::binary);
+	if (!f) return false;
+	//cache is consumed, it is written again on exit. Crash doesn't leave stale cache
+	::unlink(cache_file.c_str());
+	auto rd = [&](auto &x) {
+		return !!f.read(reinterpret_cast<char *>(&x), sizeof(x));
+	};
+	CacheHeader h;
+	if (!rd(h) || std::memcmp(h.magic, cacheMagic, sizeof(cacheMagic)) != 0) return false;
+	if (std::make_pair(h.data_size, h.last_checksum) != db.getState()) return false;
+	auto load = [&](auto &aggr, std::uint64_t count) {
+		std::string symbol;
+		for (std::uint64_t i = 0; i < count; i++) {
+			Day d;
+			std::uint32_t cnt;
+			if (!rd(d) || !rd(cnt)) return false;
+			if (cnt == invalidItem) {
+				aggr.invalidate(d);
+				continue;
+			}
+			SymbolMap smap;
+			for (std::uint32_t j = 0; j < cnt; j++) {
+				std::uint32_t len;
+				AggrVal v;
+				if (!rd(len)) return false;
+				symbol.resize(len);
+				if (!f.read(symbol.data(), len) || !rd(v)) return false;
+				smap.emplace(storeSymbol(symbol), v);
+			}
+			aggr.assign(d, std::move(smap));
+		}
+		return true;
+	};
+	if (!load(days, h.days) || !load(months, h.months)) {
+		days.clear();
+		months.clear();
+		return false;
+	}
+	return true;
+}
+
+void TradeReport::saveCache() const {
+	std::string tmpname = cache_file+".tmp";
+	{
+		std::ofstream f(tmpname, std::ios::out|std::ios::binary|std::ios::trunc);
+		auto wr = [&](const auto &x) {
+			f.write(reinterpret_cast<const char *>(&x), sizeof(x));
+		};
+		auto st = db.getState();
+		CacheHeader h;
+		std::copy(std::begin(cacheMagic), std::end(cacheMagic), h.magic);
+		h.data_size = st.first;
+		h.last_checksum = st.second;
+		h.days = std::distance(days.begin(), days.end());
+		h.months = std::distance(months.begin(), months.end());
+		wr(h);
+		auto save = [&](const auto &aggr) {
+			for (const auto &x: aggr) {
+				wr(x.first);
+				if (!x.second.has_value()) {
+					wr(invalidItem);
+					continue;
+				}
+				wr(static_cast<std::uint32_t>(x.second->size()));
+				for (const auto &y: *x.second) {
+					wr(static_cast<std::uint32_t>(y.first.size()));
+					f.write(y.first.data(), y.first.size());
+					wr(y.second);
+				}
+			}
+		};
+		save(days);
+		save(months);
+		if (!f) {
+			::unlink(tmpname.c_str());
+			return;
+		}
+	}
+	::rename(tmpname.c_str(), cache_file.c_str());
+}
+
 void TradeReport::reset() {
 
 	for (const auto &x: db.days()) {
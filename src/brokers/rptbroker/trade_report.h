@@ -7,6 +7,7 @@
 
 #ifndef SRC_BROKERS_RPTBROKER_TRADE_REPORT_H_
 #define SRC_BROKERS_RPTBROKER_TRADE_REPORT_H_
+#include <algorithm>
 #include <set>
 #include <vector>
 
@@ -27,7 +28,13 @@ public:
 	};
 	using SymbolMap = std::map<std::string_view, AggrVal>;
 
-	TradeReport(DataBase &db);
+	///Constructs report
+	/**
+	 * @param db database
+	 * @param cache_file file where aggregated values are stored between sessions
+	 */
+	TradeReport(DataBase &db, const std::string &cache_file);
+	~TradeReport();
 
 	struct StandardReport {
 		std::vector<std::pair<Day, SymbolMap> > months;
@@ -39,6 +46,10 @@ public:
 
 	void invalidate(std::uint64_t tm);
 	void reset();
+	///Updates aggregated values by trade added to the database
+	void addTrade(const DataBase::Header &hdr, const DataBase::Trade &trade);
+	///Updates aggregated values by trade replaced in the database
+	void replaceTrade(const DataBase::Header &hdr, const DataBase::Trade &old_trade, const DataBase::Trade &new_trade);
 
 	struct Filter {
 		std::optional<std::string> asset, currency, broker;
@@ -83,10 +94,18 @@ protected:
 	std::string_view storeSymbol(const std::string_view &symbol) const;
 
 	DataBase &db;
+	std::string cache_file;
 	mutable SymbolSet sset;
 	Months months;
 	Days days;
 
+	///Applies change of the trade to the aggregated values
+	void applyDelta(const DataBase::Header &hdr, const AggrVal &delta, bool insert);
+	static AggrVal tradeValue(const DataBase::Trade &trade);
+	///Loads aggregated values, if they match the database
+	bool loadCache();
+	void saveCache() const;
+
 	SymbolMap buildMap(std::streampos from, std::streampos to) const;
 	SymbolMap merge(const SymbolMap &a, const SymbolMap &b) const;
 	void rereduce(SymbolMap &a, const SymbolMap &b) const;
@@ -97,26 +116,38 @@ inline void TradeReport::query(Fn &&fn, const Date &start, const Date &end, off_
 	off_t pos = db.findDay(start);
 	off_t pend = db.findDay(end);
 	pos = std::max(pos, cursor);
-	bool needTrader = filter.asset.has_value() || filter.currency.has_value() || filter.broker.has_value();
-	db.scanTradesFrom(pos, [&](off_t pos, const DataBase::Header &hdr, const DataBase::Trade &trade){
-		if (pos >= pend) return false;
-		if (trade.deleted && filter.skip_deleted) return true;
-		const DataBase::TraderInfo *nfo = nullptr;
-		if (needTrader) {
-			nfo = db.findTrader(hdr);
-			if (!nfo) return true;
-			if (filter.asset.has_value() && nfo->getAsset() != *filter.asset) return true;
-			if (filter.currency.has_value() && nfo->getCurrency() != *filter.currency) return true;
-			if (filter.broker.has_value() && nfo->getBroker() != *filter.broker) return true;
+	if (filter.uid.has_value() || filter.magic.has_value() || filter.asset.has_value()
+			|| filter.currency.has_value() || filter.broker.has_value()) {
+		//filtered query - read only trades of matching traders
+		std::vector<off_t> offsets;
+		for (const auto &t: db.traders()) {
+			const DataBase::TraderInfo &nfo = t.second;
+			if (filter.uid.has_value() && t.first.first != *filter.uid) continue;
+			if (filter.magic.has_value() && t.first.second != *filter.magic) continue;
+			if (filter.asset.has_value() && nfo.getAsset() != *filter.asset) continue;
+			if (filter.currency.has_value() && nfo.getCurrency() != *filter.currency) continue;
+			if (filter.broker.has_value() && nfo.getBroker() != *filter.broker) continue;
+			const auto &lst = db.findTrades(t.first);
+			offsets.insert(offsets.end(),
+					std::lower_bound(lst.begin(), lst.end(), pos),
+					std::lower_bound(lst.begin(), lst.end(), pend));
 		}
-		if (filter.uid.has_value() && hdr.uid != *filter.uid) return true;
-		if (filter.magic.has_value() && hdr.magic != *filter.magic) return true;
-		if (!nfo) {
-			nfo = db.findTrader(hdr);
+		std::sort(offsets.begin(), offsets.end());
+		db.scanTradesAt(offsets, [&](off_t pos, const DataBase::Header &hdr, const DataBase::Trade &trade){
+			if (trade.deleted && filter.skip_deleted) return true;
+			const DataBase::TraderInfo *nfo = db.findTrader(hdr);
 			if (!nfo) return true;
-		}
-		return fn(pos,hdr,trade, *nfo);
-	});
+			return fn(pos,hdr,trade, *nfo);
+		});
+	} else {
+		db.scanTradesFrom(pos, [&](off_t pos, const DataBase::Header &hdr, const DataBase::Trade &trade){
+			if (pos >= pend) return false;
+			if (trade.deleted && filter.skip_deleted) return true;
+			const DataBase::TraderInfo *nfo = db.findTrader(hdr);
+			if (!nfo) return true;
+			return fn(pos,hdr,trade, *nfo);
+		});
+	}
 }
 
 template<typename Fn>
@@ -63,6 +63,7 @@ public:
 	HTTPJson hjsn_utils;
 	std::unique_ptr<QuoteStream> qstream;
 	std::unique_ptr<Market> market;
+	PQuoteDistributor qdist;
 
 
 
@@ -75,7 +76,7 @@ public:
 	PTradingEngine getEngine(const std::string &symbol) {
 		try {
 			if (market == nullptr) {
-				PQuoteDistributor qdist = new QuoteDistributor();
+				qdist = new QuoteDistributor();
 				qstream = std::make_unique<QuoteStream>(httpc,"https://web-quotes-core.simplefx.com/websocket/quotes", qdist->createReceiveFn());
 				qdist->connect(qstream->connect());
 				market = std::make_unique<Market>(qdist, [this](const std::string &symbol, double amount, double last_price){
@@ -384,6 +385,11 @@ inline json::Value Interface::placeOrder(const std::string_view &pair,
 
 inline bool Interface::reset() {
 	login();
+	if (qdist != nullptr) {
+		for (const auto &st: qdist->getStats()) {
+			logDebug("Quotes: $1 - total: $2, rate: $3/min", st.symbol, st.quotes, st.rate);
+		}
+	}
 	return true;
 }
 
@@ -7,7 +7,13 @@
 
 #include "quotedist.h"
 
+#include <algorithm>
 #include <cmath>
+
+QuoteDistributor::~QuoteDistributor() {
+	delete table.load();
+}
+
 RegisterPriceChangeEvent QuoteDistributor::createRegFn(const std::string_view &symbol) {
 	return [me = PQuoteDistributor(this), symbol = std::string(symbol)](OnPriceChange &&fn) {
 		me->subscribe(symbol, std::move(fn));
@@ -26,43 +32,109 @@ void QuoteDistributor::connect(SubscribeFn &&subfn) {
 }
 
 bool QuoteDistributor::receiveQuotes(const std::string_view &symbol, double bid, double ask, std::uint64_t time) {
-	Sync _(lock);
-	std::string s(symbol);
-	auto r = listeners.equal_range(s);
-	if (r.first == r.second) {
-		return false;
+	readers.fetch_add(1);
+	const Table *t = table.load();
+	bool found = false;
+	if (t) {
+		auto iter = std::lower_bound(t->begin(), t->end(), symbol, [](const TableItem &itm, const std::string_view &s) {
+			return itm.name < s;
+		});
+		if (iter != t->end() && iter->name == symbol) {
+			iter->symbol->quotes.fetch_add(1, std::memory_order_relaxed);
+
+			IStockApi::Ticker tk{
+					bid,
+					ask,
+					sqrt(bid*ask),
+					time
+				};
+
+			for (const PListener &l: iter->listeners) {
+				if (l->active.load(std::memory_order_relaxed)) {
+					if (l->fn(tk)) {
+						found = true;
+					} else {
+						l->active = false;
+						dirty = true;
+					}
+				}
+			}
+		}
 	}
+	readers.fetch_sub(1);
+	return found;
+}
+
+QuoteDistributor::Symbol *QuoteDistributor::intern(const std::string_view &symbol) {
+	auto iter = symbol_map.find(symbol);
+	if (iter != symbol_map.end()) return iter->second;
+	symbols.push_back(std::make_unique<Symbol>(std::string(symbol)));
+	Symbol *s = symbols.back().get();
+	symbol_map.emplace(s->name, s);
+	return s;
+}
 
-	IStockApi::Ticker tk{
-			bid,
-			ask,
-			sqrt(bid*ask),
-			time
-		};
-
-	for (auto x = r.first; x != r.second;) {
-		if (!(*x).second(tk)) {
-			x = listeners.erase(x);
-		} else {
-			++x;
+std::unique_ptr<QuoteDistributor::Table> QuoteDistributor::copyTable() const {
+	auto out = std::make_unique<Table>();
+	const Table *t = table.load();
+	if (t) {
+		out->reserve(t->size());
+		for (const TableItem &itm: *t) {
+			TableItem nitm{itm.name, itm.symbol, {}};
+			std::copy_if(itm.listeners.begin(), itm.listeners.end(), std::back_inserter(nitm.listeners), [](const PListener &l){
+				return l->active.load();
+			});
+			if (!nitm.listeners.empty()) out->push_back(std::move(nitm));
 		}
 	}
-	return true;
+	return out;
+}
+
+void QuoteDistributor::publish(std::unique_ptr<Table> &&t) {
+	const Table *old = table.exchange(t.release());
+	if (old) retired.emplace_back(old);
+	//no reader - nobody can see retired tables
+	if (readers.load() == 0) retired.clear();
 }
 
 void QuoteDistributor::subscribe(const std::string_view &symbol, OnPriceChange &&listener) {
 	Sync _(lock);
 
-	std::string s (symbol);
-
-	auto r = listeners.equal_range(s);
-	if (r.first == r.second) {
-		subfn(symbol);
+	dirty = false;
+	auto t = copyTable();
+	Symbol *s = intern(symbol);
+	auto iter = std::lower_bound(t->begin(), t->end(), s->name, [](const TableItem &itm, const std::string_view &n) {
+		return itm.name < n;
+	});
+	if (iter == t->end() || iter->name != s->name) {
+		iter = t->insert(iter, TableItem{s->name, s, {}});
+		if (subfn) subfn(symbol);
 	}
+	iter->listeners.push_back(std::make_shared<Listener>(std::move(listener)));
+	publish(std::move(t));
+}
 
-	listeners.emplace(std::move(s), std::move(listener));
+std::vector<QuoteDistributor::QuoteStats> QuoteDistributor::getStats() {
+	Sync _(lock);
+	if (dirty) {
+		dirty = false;
+		publish(copyTable());
+	} else if (readers.load() == 0) {
+		retired.clear();
+	}
+	auto now = std::chrono::steady_clock::now();
+	std::vector<QuoteStats> out;
+	for (const auto &s: symbols) {
+		std::uint64_t q = s->quotes.load(std::memory_order_relaxed);
+		double mins = std::chrono::duration_cast<std::chrono::duration<double, std::ratio<60> > >(now - s->last_time).count();
+		out.push_back({s->name, q, mins > 0?(q - s->last_quotes)/mins:0.0});
+		s->last_quotes = q;
+		s->last_time = now;
+	}
+	return out;
 }
 
 void QuoteDistributor::disconnect() {
+	Sync _(lock);
 	subfn = nullptr;
 }
@@ -8,34 +8,102 @@
 #ifndef SRC_SIMPLEFX_QUOTEDIST_H_
 #define SRC_SIMPLEFX_QUOTEDIST_H_
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 #include "datasrc.h"
 #include "fndef.h"
 
 class QuoteDistributor;
 using PQuoteDistributor = ondra_shared::RefCntPtr<QuoteDistributor>;
 
+///Distributes quotes to the listeners
+/**
+ * Symbols are interned, the table refers to names owned by the distributor. Listeners are
+ * stored in an immutable table sorted by the symbol name, which is replaced as whole when
+ * a listener is added or removed (RCU). Receiving of the quote doesn't lock nor allocate,
+ * it only binary-searches the table. The old table is released once there is no reader,
+ * which could see it.
+ */
 class QuoteDistributor: public ondra_shared::RefCntObj {
 public:
 
+	~QuoteDistributor();
+
 	RegisterPriceChangeEvent createRegFn(const std::string_view &symbol);
 	ReceiveQuotesFn createReceiveFn();
 	void connect(SubscribeFn &&subfn);
 	void disconnect();
 
+	struct QuoteStats {
+		std::string symbol;
+		///total count of quotes
+		std::uint64_t quotes;
+		///quotes per minute since the last call
+		double rate;
+	};
+
+	///Retrieves count of quotes per symbol
+	std::vector<QuoteStats> getStats();
 
 protected:
 
-	std::recursive_mutex lock;
-	using Sync = std::unique_lock<std::recursive_mutex>;
+	std::mutex lock;
+	using Sync = std::unique_lock<std::mutex>;
 
 	SubscribeFn subfn;
 
-	std::unordered_multimap<std::string, OnPriceChange> listeners;
+	struct Listener {
+		OnPriceChange fn;
+		///set to false, when listener asked to stop
+		std::atomic<bool> active = true;
+		Listener(OnPriceChange &&fn):fn(std::move(fn)) {}
+	};
+
+	using PListener = std::shared_ptr<Listener>;
+
+	struct Symbol {
+		std::string name;
+		std::atomic<std::uint64_t> quotes = 0;
+		std::uint64_t last_quotes = 0;
+		std::chrono::steady_clock::time_point last_time = std::chrono::steady_clock::now();
+		Symbol(std::string &&name):name(std::move(name)) {}
+	};
+
+	struct TableItem {
+		std::string_view name;
+		Symbol *symbol;
+		std::vector<PListener> listeners;
+	};
+
+	///Listeners ordered by symbol name - immutable, once it is published
+	using Table = std::vector<TableItem>;
+
+	///Interned symbols, symbols are never removed
+	std::vector<std::unique_ptr<Symbol> > symbols;
+	std::unordered_map<std::string_view, Symbol *> symbol_map;
+
+	///Current table
+	std::atomic<const Table *> table = nullptr;
+	///Count of readers which currently access a table
+	std::atomic<unsigned int> readers = 0;
+	///Replaced tables waiting to release
+	std::vector<std::unique_ptr<const Table> > retired;
+	///Some listener asked to stop, table can be cleaned
+	std::atomic<bool> dirty = false;
 
 	bool receiveQuotes(const std::string_view &symbol, double bid, double ask, std::uint64_t time);
 	void subscribe(const std::string_view &symbol, OnPriceChange &&listener);
+	Symbol *intern(const std::string_view &symbol);
+	///Publishes new table (under lock)
+	void publish(std::unique_ptr<Table> &&t);
+	///Creates copy of current table without stopped listeners (under lock)
+	std::unique_ptr<Table> copyTable() const;
 
 
 };
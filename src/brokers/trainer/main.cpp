@@ -347,6 +347,8 @@ public:
 };
 
 
+MMBOT_BROKER_PLUGIN(Interface)
+
 int main(int argc, char **argv) {
 	using namespace json;
 
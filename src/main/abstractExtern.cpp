@@ -18,15 +18,20 @@
 #include <poll.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <dlfcn.h>
 #include <shared/filesystem.h>
 
+#include <algorithm>
 #include <cstring>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <thread>
 
 #include <imtjson/binjson.tcc>
 
 #include "../shared/linux_waitpid.h"
+#include "brokerplugin.h"
 #include "istockapi.h"
 
 const int AbstractExtern::invval = -1;
@@ -70,11 +75,7 @@ void parseArguments(std::string_view args, Fn &&result) {
 }
 
 template<typename Fn>
-void parseArgumentList(std::string_view args, Fn &&result) {
-	std::vector<std::string> data;
-	parseArguments(args,[&](const std::string &arg) {
-		data.emplace_back(arg);
-	});
+void argumentList(std::vector<std::string> data, Fn &&result) {
 	std::vector<char *> ptrs;
 	for (auto &&x:data) {
 		ptrs.push_back(const_cast<char *>(x.c_str()));
@@ -117,17 +118,31 @@ void AbstractExtern::spawn() {
 	int status;
 	//collect any zombie
 	waitpid(-1,&status,WNOHANG);
+	++generation;
 
 	{
 
 		log.progress("Connecting to broker: cmdline='$1', workdir='$2'", cmdline, workingDir);
 
+		std::vector<std::string> args;
+		parseArguments(cmdline, [&](const std::string &arg) {
+			args.push_back(arg);
+		});
+		if (!args.empty() && args[0].size() > 3 && args[0].compare(args[0].size()-3, 3, ".so") == 0) {
+			if (!plugin_failed && openPlugin(args)) {
+				onConnect();
+				return;
+			}
+			//fallback to subprocess - executable has the same name without the extension
+			args[0].resize(args[0].size()-3);
+		}
+
 		Pipe proc_input (makePipe());
 		Pipe proc_output (makePipe());
 		Pipe proc_error (makePipe());
 		Pipe proc_control (makePipe());
 
-		parseArgumentList(cmdline, [&](char * const arglist[]) {
+		argumentList(std::move(args), [&](char * const arglist[]) {
 
 			pid_t frk = fork();
 			if (frk == -1) {
@@ -179,13 +194,122 @@ void AbstractExtern::spawn() {
 
 }
 
+///Libraries which have an open instance of the broker
+/** The library is loaded only once per process, so the instances would share its static
+ * state. Other instance of the same library runs as subprocess */
+static std::mutex plugins_in_use_lock;
+static std::set<std::string> plugins_in_use;
+
+struct AbstractExtern::Plugin {
+	MMBotPluginCallFn call;
+	MMBotPluginCloseFn close;
+	void *handle;
+	std::string libpath;
+	~Plugin() {
+		close(handle);
+		std::lock_guard _(plugins_in_use_lock);
+		plugins_in_use.erase(libpath);
+	}
+};
+
+bool AbstractExtern::openPlugin(const std::vector<std::string> &args) {
+	//paths are relative to the working directory as in the subprocess mode
+	auto resolve = [&](const std::string &p) {
+		std::filesystem::path path(p);
+		if (path.is_relative()) path = std::filesystem::path(workingDir) / path;
+		return path.string();
+	};
+	std::string libpath = resolve(args[0]);
+	std::string storage = args.size()>1?resolve(args[1]):std::string();
+	{
+		std::error_code ec;
+		auto canon = std::filesystem::weakly_canonical(libpath, ec);
+		if (!ec) libpath = canon.string();
+		std::lock_guard _(plugins_in_use_lock);
+		if (!plugins_in_use.insert(libpath).second) {
+			log.note("Broker plugin is already used by other instance - using subprocess: $1", libpath);
+			return false;
+		}
+	}
+	//library is never unloaded, because it can still run threads or hold static objects
+	void *lib = dlopen(libpath.c_str(), RTLD_NOW|RTLD_LOCAL);
+	const char *err = nullptr;
+	MMBotPluginOpenFn open_fn = nullptr;
+	MMBotPluginCallFn call_fn = nullptr;
+	MMBotPluginCloseFn close_fn = nullptr;
+	if (lib == nullptr) {
+		err = dlerror();
+	} else {
+		open_fn = reinterpret_cast<MMBotPluginOpenFn>(dlsym(lib, MMBOT_PLUGIN_OPEN));
+		call_fn = reinterpret_cast<MMBotPluginCallFn>(dlsym(lib, MMBOT_PLUGIN_CALL));
+		close_fn = reinterpret_cast<MMBotPluginCloseFn>(dlsym(lib, MMBOT_PLUGIN_CLOSE));
+		if (!open_fn || !call_fn || !close_fn) err = "Library doesn't export broker plugin interface";
+	}
+	if (err) {
+		log.warning("Unable to load broker plugin: $1 - using subprocess", err);
+		plugin_failed = true;
+		std::lock_guard _(plugins_in_use_lock);
+		plugins_in_use.erase(libpath);
+		return false;
+	}
+	auto p = std::make_shared<Plugin>();
+	p->call = call_fn;
+	p->close = close_fn;
+	p->libpath = libpath;
+	p->handle = open_fn(storage.c_str(), &pluginLog, this);
+	plugin = std::move(p);
+	log.progress("Broker loaded as plugin: $1", libpath);
+	return true;
+}
+
+void AbstractExtern::pluginLog(void *ctx, const char *data, std::size_t size) {
+	static_cast<AbstractExtern *>(ctx)->log.note("stderr: $1", std::string(data, size));
+}
+
+json::Value AbstractExtern::pluginExchange(json::Value request, Sync &sync) {
+	auto p = plugin;
+	//broker, which accepted the multiplexed mode, is thread safe
+	if (mux_mode) sync.unlock();
+	bool verbose = log.isLogLevelEnabled(ondra_shared::LogLevel::debug);
+	if (verbose) log.debug("SEND: $1", request.toString().substr(0,512));
+	std::string buff;
+	request.serializeBinary([&](char c){buff.push_back(c);}, json::compressKeys);
+	std::string resp;
+	p->call(p->handle, buff.data(), buff.size(), [](void *ctx, const char *data, std::size_t size) {
+		static_cast<std::string *>(ctx)->append(data, size);
+	}, &resp);
+	std::size_t pos = 0;
+	auto ret = json::Value::parseBinary([&]{
+		return pos < resp.size()?static_cast<unsigned char>(resp[pos++]):EOF;
+	}, json::base64);
+	if (verbose) log.debug("RECV: $1", ret.toString().substr(0,512));
+	return ret;
+}
+
+bool AbstractExtern::isRunning() const {
+	Sync _(lock);
+	return chldid != -1 || plugin != nullptr;
+}
+
 void AbstractExtern::handleClose(int fd) {
 	::close(fd);
 }
 
 
+void AbstractExtern::kill(unsigned int gen) {
+	Sync _(lock);
+	//the broker has been already restarted, the failure belongs to the previous instance
+	if (gen != generation) return;
+	kill();
+}
+
 void AbstractExtern::kill() {
 	Sync _(lock);
+	if (plugin != nullptr) {
+		//pending calls hold own reference, the broker is destroyed by the last one
+		plugin.reset();
+		log.note("Broker plugin disconnected");
+	}
 	if (chldid != -1) {
 
 		ondra_shared::WaitPid wpid(chldid);
@@ -207,6 +331,12 @@ void AbstractExtern::kill() {
 		}
 		chldid = -1;
 	}
+	std::unique_lock ml(mux_lock);
+	muxFail("Broker process disconnected");
+	//wait for reader, it must not read from closed pipe
+	mux_cond.wait(ml, [&]{return !mux_reading;});
+	mux_reader.reset();
+	mux_mode = false;
 }
 
 AbstractExtern::~AbstractExtern() {
@@ -241,6 +371,9 @@ public:
 	void putback(std::string_view data) {
 		buff = data;
 	}
+	bool hasData() const {
+		return !buff.empty();
+	}
 
 	int operator()() {
 		auto d = read();
@@ -294,7 +427,7 @@ bool AbstractExtern::writeJSON(json::Value v, FD& fd, bool binary_mode, int time
 bool AbstractExtern::preload() {
 	try {
 		Sync _(lock);
-		if (chldid == -1) {
+		if (!isRunning()) {
 			spawn();
 			return true;
 		} else {
@@ -398,10 +531,148 @@ json::Value AbstractExtern::jsonExchange(json::Value request) {
 	} while (true);
 }
 
+json::Value AbstractExtern::exchange(json::Value request) {
+	Sync sync(lock);
+	if (!isRunning()) {
+		spawn();
+	}
+	if (plugin != nullptr) return pluginExchange(request, sync);
+	if (mux_mode) return jsonMuxExchange(request, sync);
+	else return jsonExchange(request);
+}
+
+json::Value AbstractExtern::jsonMuxExchange(json::Value request, Sync &sync) {
+	MuxSlot slot;
+	int id = msgCntr++;
+	bool verbose = log.isLogLevelEnabled(ondra_shared::LogLevel::debug);
+	if (verbose) log.debug("SEND[$1]: $2", id, request.toString().substr(0,512));
+	slot.deadline = std::chrono::system_clock::now()+std::chrono::milliseconds(timeout);
+	unsigned int gen = generation;
+	{
+		std::lock_guard _(mux_lock);
+		mux_pending.emplace(id, &slot);
+	}
+	if (writeJSON({id, request[0], request[1]}, extin, binary_mode, timeout) == false) {
+		kill();
+		throw std::runtime_error("Connection to API lost (write)");
+	}
+	//other requests can be sent while we are waiting
+	sync.unlock();
+
+	std::unique_lock ml(mux_lock);
+	while (!slot.done) {
+		if (mux_reading) {
+			mux_cond.wait(ml);
+		} else {
+			//nobody is reading, so this thread becomes reader
+			mux_reading = true;
+			ml.unlock();
+			std::string error;
+			try {
+				muxRead();
+			} catch (std::exception &e) {
+				error = e.what();
+			}
+			ml.lock();
+			mux_reading = false;
+			if (!error.empty()) {
+				muxFail(error);
+				mux_cond.notify_all();
+				ml.unlock();
+				kill(gen);
+				ml.lock();
+			} else {
+				mux_cond.notify_all();
+			}
+		}
+	}
+	if (!slot.error.empty()) throw std::runtime_error(slot.error);
+	if (verbose) log.debug("RECV[$1]: $2", id, slot.response.toString().substr(0,512));
+	return slot.response;
+}
+
+void AbstractExtern::muxFail(const std::string &error) {
+	for (auto &x: mux_pending) {
+		x.second->error = error;
+		x.second->done = true;
+	}
+	mux_pending.clear();
+	mux_cond.notify_all();
+}
+
+void AbstractExtern::muxRead() {
+	int tm;
+	{
+		std::lock_guard _(mux_lock);
+		if (mux_pending.empty()) return;
+		auto deadline = std::min_element(mux_pending.begin(), mux_pending.end(), [](const auto &a, const auto &b){
+			return a.second->deadline < b.second->deadline;
+		})->second->deadline;
+		auto now = std::chrono::system_clock::now();
+		if (now >= deadline) report_timeout();
+		tm = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+		if (!mux_reader) mux_reader = std::make_unique<Reader>(extout, timeout);
+	}
+	Reader &rd = *mux_reader;
+	if (!rd.hasData()) {
+		struct pollfd fds[2];
+		fds[0].fd = extout;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = exterr;
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+		int r = poll(fds,2,tm);
+		if (r == 0) report_timeout();
+		if (r < 0) report_error("poll");
+		if (fds[1].revents) {
+			char buff[1000];
+			int i = ::read(exterr, buff, sizeof(buff));
+			if (i < 1) throw std::runtime_error("Connection to API lost (stderr)");
+			std::string_view lines(buff, i);
+			auto pos = lines.find('\n');
+			while (pos != lines.npos) {
+				log.note("stderr: $1", std::string(lines.substr(0,pos)));
+				lines = lines.substr(pos+1);
+				pos = lines.find('\n');
+			}
+			if (!lines.empty()) log.note("stderr: $1", std::string(lines));
+		}
+		if (!fds[0].revents) return;
+	}
+	auto buff = rd.read();
+	if (buff.empty()) throw std::runtime_error("Connection to API lost");
+	while (!buff.empty() && isspace(buff[0])) {
+		buff = buff.substr(1);
+	}
+	if (buff.empty()) {
+		//broker requested more time - we don't know which request, so extend all
+		log.debug("Broker requested more time");
+		std::lock_guard _(mux_lock);
+		auto deadline = std::chrono::system_clock::now()+std::chrono::milliseconds(timeout);
+		for (auto &x: mux_pending) x.second->deadline = std::max(x.second->deadline, deadline);
+		return;
+	}
+	rd.putback(buff);
+	auto ret = binary_mode
+			?json::Value::parseBinary<Reader &>(rd, json::base64)
+			:json::Value::parse<Reader &>(rd);
+	//untagged response is fatal error reported by the broker
+	if (ret[0].type() != json::number) throw std::runtime_error(ret[1].toString().str());
+	std::lock_guard _(mux_lock);
+	auto iter = mux_pending.find(ret[0].getInt());
+	if (iter == mux_pending.end()) {
+		log.warning("Unexpected response: $1", ret.toString().substr(0,512));
+		return;
+	}
+	iter->second->response = {ret[1], ret[2]};
+	iter->second->done = true;
+	mux_pending.erase(iter);
+}
+
 json::Value AbstractExtern::jsonRequestExchange(json::String name, json::Value args) {
-	Sync _(lock);
 	try {
-		auto resp = jsonExchange({name, args});
+		auto resp = exchange({name, args});
 		if (resp[0].getBool() == true) {
 			auto result = resp[1];
 			return result;
@@ -7,7 +7,13 @@
 
 #ifndef SRC_MAIN_ABSTRACTEXTERN_H_
 #define SRC_MAIN_ABSTRACTEXTERN_H_
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <imtjson/string.h>
 #include <imtjson/value.h>
@@ -24,6 +30,8 @@ public:
 	bool preload();
 	virtual void onConnect() {}
 	void stop();
+	///Returns true, if the broker is running (as a process or a plugin)
+	bool isRunning() const;
 
 	///Send request
 	/**
@@ -69,6 +77,8 @@ protected:
 	FD extout;
 	FD exterr;
 	pid_t chldid = -1;
+	///incremented by every spawn(), identifies the running instance of the broker
+	unsigned int generation = 0;
 	std::string name;
 	std::string cmdline;
 	std::string workingDir;
@@ -80,14 +90,48 @@ protected:
 
 	class Reader;
 
+	///Broker loaded as shared library into this process
+	struct Plugin;
+	std::shared_ptr<Plugin> plugin;
+	///set to true, when plugin failed to load - subprocess is used instead
+	bool plugin_failed = false;
+
 	void spawn();
 	void kill();
+	///kills the broker only if it is still the instance identified by the generation
+	void kill(unsigned int gen);
+	bool openPlugin(const std::vector<std::string> &args);
+	json::Value pluginExchange(json::Value request, Sync &sync);
+	static void pluginLog(void *ctx, const char *data, std::size_t size);
 
 	static Pipe makePipe();
 	int msgCntr = 1;
 	bool binary_mode = false;
+	///multiplexed mode - requests are tagged by id, responses can arrive out of order
+	/** The mode must be negotiated in the onConnect() */
+	std::atomic<bool> mux_mode = false;
+
+	///Pending multiplexed request
+	struct MuxSlot {
+		json::Value response;
+		std::string error;
+		std::chrono::system_clock::time_point deadline;
+		bool done = false;
+	};
+
+	std::mutex mux_lock;
+	std::condition_variable mux_cond;
+	std::unordered_map<int, MuxSlot *> mux_pending;
+	///true, if a thread is reading responses for all waiting requests
+	bool mux_reading = false;
+	///reader must be persistent, it can hold part of next response
+	std::unique_ptr<Reader> mux_reader;
 
+	json::Value exchange(json::Value request);
 	json::Value jsonExchange(json::Value request);
+	json::Value jsonMuxExchange(json::Value request, Sync &sync);
+	void muxRead();
+	void muxFail(const std::string &error);
 	static bool writeJSON(json::Value v, FD &fd, bool binary_mode, int timeout);
 //	static json::Value readJSON(FD &fd, int timeout);
 	static bool writeString(std::string_view ss, int timeout, FD &fd);
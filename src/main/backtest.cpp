@@ -1,65 +1,84 @@
 #include <imtjson/value.h>
 #include "backtest.h"
 
+#include <algorithm>
 #include <cmath>
+#include <future>
+#include <memory>
 
 #include "../imtjson/src/imtjson/object.h"
 #include "istatsvc.h"
 #include "mtrader.h"
 #include "sgn.h"
+#include "walletDB.h"
 
 using TradeRec=IStatSvc::TradeRecord;
 using Trade=IStockApi::Trade;
 using Ticker=IStockApi::Ticker;
 
-BTTrades backtest_cycle(const MTrader_Config &cfg, BTPriceSource &&priceSource, const IStockApi::MarketInfo &minforef, std::optional<double> init_pos, double balance, bool neg_bal, bool spend) {
-
-    IStockApi::MarketInfo minfo = minforef;
+BTTrades backtest_cycle(const MTrader_Config &cfg, BTPriceSource &&priceSource, const IStockApi::MarketInfo &minfo, std::optional<double> init_pos, double balance, bool neg_bal, bool spend) {
 	BTTrades trades;
-	try {
-		std::optional<BTPrice> price = priceSource();
-		if (!price.has_value()) return trades;
-
-		Strategy s = cfg.strategy;
-
-		BTTrade bt;
-		bt.price = price->price;
-		bt.time = price->time;
-
-		double pos;
-		if (init_pos.has_value() ) {
-			pos = *init_pos;
-			if (minfo.invert_price) pos = -pos;
-		}else {
-			pos = s.calcInitialPosition(minfo,bt.price,0,balance)+cfg.position_offset;
-			if (!minfo.leverage) balance -= pos * bt.price;
-			bt.size = pos;
-		}
-
-		bt.bal = balance;
-		bt.pos = pos;
+	backtest_cycle(cfg, std::move(priceSource), minfo, init_pos, balance, neg_bal, spend, [&](const BTTrade &bt){
 		trades.push_back(bt);
+		return true;
+	});
+	return trades;
+}
 
-		double total_spend = 0;
-		double pl = 0;
-		for (price = priceSource();price.has_value();price = priceSource()) {
-			minfo.min_size = std::max(minfo.min_size, cfg.min_size);
-			if (std::abs(price->price-bt.price) == 0) continue;
-			bt.event = BTEvent::no_event;
-			double p = price->price;
-			Ticker tk{p,p,p,price->time};
-			double prev_bal = balance;
-			bool enable_alert = true;
-
-			double eq = s.getCenterPrice(bt.price,pos-cfg.position_offset);
-			double dir = p>eq?-1:1;
-			s.onIdle(minfo,tk,pos-cfg.position_offset,balance);
-			double adjbal = std::max(balance,0.0);
-			bool rej = false;
-			bool invalid = false;
-			double orgsize = 0;
-			Strategy::OrderData order;
-			do {
+BTSimulator::BTSimulator(const MTrader_Config &cfg, const IStockApi::MarketInfo &minfo, bool neg_bal, bool spend, BTTradeOutput &&output)
+	:cfg(cfg),minfo(minfo),neg_bal(neg_bal),spend(spend),output(std::move(output)),s(cfg.strategy) {}
+
+bool BTSimulator::emit(const BTTrade &bt) {
+	any_trade = true;
+	if (minfo.invert_price) {
+		BTTrade x = bt;
+		x.neutral_price = 1.0/x.neutral_price;
+		x.open_price = 1.0/x.open_price;
+		x.pos = -x.pos;
+		x.price = 1.0/x.price;
+		x.size = -x.size;
+		return output(x);
+	} else {
+		return output(bt);
+	}
+}
+
+bool BTSimulator::start(const BTPrice &price, std::optional<double> init_pos, double &balance) {
+	bt.price = price.price;
+	bt.time = price.time;
+
+	if (init_pos.has_value() ) {
+		pos = *init_pos;
+		if (minfo.invert_price) pos = -pos;
+	}else {
+		pos = s.calcInitialPosition(minfo,bt.price,0,balance)+cfg.position_offset;
+		if (!minfo.leverage) balance -= pos * bt.price;
+		bt.size = pos;
+	}
+
+	bt.bal = balance;
+	bt.pos = pos;
+	return emit(bt);
+}
+
+bool BTSimulator::step(const BTPrice &price, double &balance) {
+	minfo.min_size = std::max(minfo.min_size, cfg.min_size);
+	if (std::abs(price.price-bt.price) == 0) return true;
+	bt.event = BTEvent::no_event;
+	double p = price.price;
+	Ticker tk{p,p,p,price.time};
+	double prev_bal = balance;
+	bool enable_alert = true;
+
+	double eq = s.getCenterPrice(bt.price,pos-cfg.position_offset);
+	double dir = p>eq?-1:1;
+	s.onIdle(minfo,tk,pos-cfg.position_offset,balance);
+	double adjbal = std::max(balance,0.0);
+	bool rej = false;
+	bool invalid = false;
+	double orgsize = 0;
+	Strategy::OrderData order;
+	do {
                 order = s.getNewOrder(minfo, bt.price*0.9+p*0.1, p, dir, pos-cfg.position_offset, adjbal,rej);
 
                 if (order.price) {
@@ -80,187 +99,376 @@ BTTrades backtest_cycle(const MTrader_Config &cfg, BTPriceSource &&priceSource,
                 invalid = order.size == 0;
                 if (rej) invalid = false;
                 rej = true;
-			} while (invalid);
+	} while (invalid);
 
-			double dprice = (p - bt.price);
+	double dprice = (p - bt.price);
             double pchange = pos * dprice;
             pl = pl + pchange;
             if (minfo.leverage) balance += pchange;
 
             if (cfg.max_balance.has_value()) {
-				if (pos > *cfg.max_balance) order.size = 0;
-				else if (order.size + pos > *cfg.max_balance) order.size = *cfg.max_balance - pos;
+		if (pos > *cfg.max_balance) order.size = 0;
+		else if (order.size + pos > *cfg.max_balance) order.size = *cfg.max_balance - pos;
+	}
+	if (cfg.min_balance.has_value()) {
+		if (pos < *cfg.min_balance) order.size = 0;
+		else if (order.size + pos < *cfg.min_balance) order.size = *cfg.min_balance - pos;
+	}
+	if (minfo.leverage) {
+		double max_lev = cfg.max_leverage?std::min(cfg.max_leverage,minfo.leverage):minfo.leverage;
+		double max_abs_pos = (adjbal * max_lev)/bt.price;
+		double new_pos = std::abs(pos + order.size);
+		double cur_pos = std::abs(pos);
+		if (new_pos > cur_pos && new_pos > max_abs_pos) {
+		    bt.event = BTEvent::margin_call;
+			order.size = 0;
+			orgsize = 0;
+		}
+	}
+	double minsize = minfo.calcMinSize(bt.price);
+	if (order.size && std::abs(order.size) < minsize) {
+		if (std::abs(order.size)<minsize*0.5) {
+			order.size = 0;
+		} else {
+			order.size = sgn(order.size)*minsize;
+		}
+	}
+	if (cfg.max_size && std::abs(order.size) > cfg.max_size) {
+		order.size = cfg.max_size*sgn(order.size);
+	}
+
+	if (cfg.trade_within_budget && order.size * pos > 0 && s.calcCurrencyAllocation(order.size, minfo.leverage>0)<0) {
+		order.size = 0;
+		bt.event = BTEvent::no_balance;
+	}
+
+
+	if (!minfo.leverage) {
+		if (order.size+pos < 0) {
+			order.size = -pos;
+			orgsize = order.size; //if zero - allow alert
+		}
+		double chg = order.size*p;
+		if (balance - chg < 0 || pos + order.size < -(std::abs(pos) + std::abs(order.size))*1e-10) {
+			if (neg_bal) {
+				bt.event = BTEvent::no_balance;
+			} else {
+			    order.size = balance / order.price;
+			    order.size = minfo.adjValue(order.size, minfo.asset_step, [&](double x){return std::floor(x);});
+			    if (order.size < minsize) {
+			        bt.event = BTEvent::no_balance;
+			        order.size = 0;
+                        orgsize = 0; //allow alert this time
+			    }
+                        chg = order.size*p;
 			}
-			if (cfg.min_balance.has_value()) {
-				if (pos < *cfg.min_balance) order.size = 0;
-				else if (order.size + pos < *cfg.min_balance) order.size = *cfg.min_balance - pos;
+		}
+		balance -= chg;
+		pos = pos+order.size;
+	} else {
+		if (balance <= 0 && prev_bal > 0) {
+			bt.event = BTEvent::liquidation;
+			order.size -= pos;
+		} else {
+			if (balance <= 0) {
+				bt.event = BTEvent::no_balance;
 			}
-			if (minfo.leverage) {
-				double max_lev = cfg.max_leverage?std::min(cfg.max_leverage,minfo.leverage):minfo.leverage;
-				double max_abs_pos = (adjbal * max_lev)/bt.price;
-				double new_pos = std::abs(pos + order.size);
-				double cur_pos = std::abs(pos);
-				if (new_pos > cur_pos && new_pos > max_abs_pos) {
-				    bt.event = BTEvent::margin_call;
-					order.size = 0;
-					orgsize = 0;
+			else {
+				double mb = balance + dprice * (pos + order.size);
+				if (mb < 0) {
+					bt.event = BTEvent::margin_call;
 				}
 			}
-			double minsize = minfo.calcMinSize(bt.price);
-			if (order.size && std::abs(order.size) < minsize) {
-				if (std::abs(order.size)<minsize*0.5) {
-					order.size = 0;
-				} else {
-					order.size = sgn(order.size)*minsize;
-				}
+		}
+		pos += order.size;
+	}
+
+	if (order.size == 0 && orgsize != 0 && order.alert != IStrategy::Alert::forced) {
+		enable_alert = false;
+	}
+
+	if (enable_alert) {
+		auto tres = s.onTrade(minfo, p, order.size, pos-cfg.position_offset, balance);
+		bt.neutral_price = tres.neutralPrice;
+		double norm_accum = std::isfinite(tres.normAccum)?tres.normAccum:0;
+		bt.norm_accum += norm_accum;
+		bt.norm_profit += std::isfinite(tres.normProfit)?tres.normProfit:0;
+		bt.open_price = tres.openPrice;
+		if (order.size*(order.size-norm_accum)>1) order.size -= norm_accum;
+		bt.info = s.dumpStatePretty(minfo);
+	} else {
+		bt.info = json::Object({
+			{"Rejected size", orgsize},
+			{"Min size", minsize },
+			{"Direction", dir},
+			{"Equilibrium", eq},
+		});
+	}
+	if (spend) {
+		double alloc = s.calcCurrencyAllocation(p, minfo.leverage>0);
+		if (alloc>0 && alloc<balance) {
+			total_spend += balance-alloc;
+			balance = alloc;
+		}
+	}
+
+	pos = minfo.adjValue(pos, minfo.asset_step, [](auto x){return std::round(x);});
+	bt.size = order.size;
+	bt.price = p;
+	bt.time = price.time;
+	bt.pl = pl;
+	bt.pos = pos;
+	bt.bal = balance+total_spend;
+	bt.unspend_balance= balance;
+	bt.norm_profit_total = bt.norm_profit + bt.norm_accum * p;
+
+
+
+	if (!emit(bt)) return false;
+
+	if (minfo.leverage) {
+		double minbal = std::abs(pos) * p/(2*minfo.leverage);
+		if (balance > minbal) {
+			double rbal1 = balance + pos * (price.pmin-p);
+			double rbal2 = balance + pos * (price.pmax-p);
+			bool trig = false;
+			if (rbal1 <= minbal) {
+				trig = true;
+				bt.price = price.pmin;
+			} else if (rbal2 <= minbal) {
+				trig = true;
+				bt.price = price.pmax;
 			}
-			if (cfg.max_size && std::abs(order.size) > cfg.max_size) {
-				order.size = cfg.max_size*sgn(order.size);
+			if (trig) {
+				double df = pos * (bt.price - p);
+				pl += df;
+				balance += df;
+				bt.pos = 0;
+				bt.bal = balance + total_spend;
+				bt.unspend_balance = balance;
+				bt.norm_profit_total = 0;
+				bt.norm_profit = 0;
+				bt.norm_accum = 0;
+				bt.event = BTEvent::liquidation;
+				bt.size = -pos;
+				bt.pl = pl;
+				bt.info = json::object;
+				if (!emit(bt)) return false;
+                        pos = 0;
 			}
 
-			if (cfg.trade_within_budget && order.size * pos > 0 && s.calcCurrencyAllocation(order.size, minfo.leverage>0)<0) {
-				order.size = 0;
-				bt.event = BTEvent::no_balance;
-			}
+		}
+	}
 
+	return true;
+}
 
-			if (!minfo.leverage) {
-				if (order.size+pos < 0) {
-					order.size = -pos;
-					orgsize = order.size; //if zero - allow alert
-				}
-				double chg = order.size*p;
-				if (balance - chg < 0 || pos + order.size < -(std::abs(pos) + std::abs(order.size))*1e-10) {
-					if (neg_bal) {
-						bt.event = BTEvent::no_balance;
-					} else {
-					    order.size = balance / order.price;
-					    order.size = minfo.adjValue(order.size, minfo.asset_step, [&](double x){return std::floor(x);});
-					    if (order.size < minsize) {
-					        bt.event = BTEvent::no_balance;
-					        order.size = 0;
-	                        orgsize = 0; //allow alert this time
-					    }
-                        chg = order.size*p;
-					}
-				}
-				balance -= chg;
-				pos = pos+order.size;
-			} else {
-				if (balance <= 0 && prev_bal > 0) {
-					bt.event = BTEvent::liquidation;
-					order.size -= pos;
-				} else {
-					if (balance <= 0) {
-						bt.event = BTEvent::no_balance;
-					}
-					else {
-						double mb = balance + dprice * (pos + order.size);
-						if (mb < 0) {
-							bt.event = BTEvent::margin_call;
-						}
-					}
-				}
-				pos += order.size;
-			}
+double BTSimulator::getAllocation() const {
+	return s.calcCurrencyAllocation(bt.price, minfo.leverage>0);
+}
 
-			if (order.size == 0 && orgsize != 0 && order.alert != IStrategy::Alert::forced) {
-				enable_alert = false;
-			}
+double BTSimulator::getPositionValue() const {
+	return minfo.leverage?0:pos * bt.price;
+}
 
-			if (enable_alert) {
-				auto tres = s.onTrade(minfo, p, order.size, pos-cfg.position_offset, balance);
-				bt.neutral_price = tres.neutralPrice;
-				double norm_accum = std::isfinite(tres.normAccum)?tres.normAccum:0;
-				bt.norm_accum += norm_accum;
-				bt.norm_profit += std::isfinite(tres.normProfit)?tres.normProfit:0;
-				bt.open_price = tres.openPrice;
-				if (order.size*(order.size-norm_accum)>1) order.size -= norm_accum;
-				bt.info = s.dumpStatePretty(minfo);
-			} else {
-				bt.info = json::Object({
-					{"Rejected size", orgsize},
-					{"Min size", minsize },
-					{"Direction", dir},
-					{"Equilibrium", eq},
-				});
-			}
-			if (spend) {
-				double alloc = s.calcCurrencyAllocation(p, minfo.leverage>0);
-				if (alloc>0 && alloc<balance) {
-					total_spend += balance-alloc;
-					balance = alloc;
-				}
-			}
+void backtest_cycle(const MTrader_Config &cfg, BTPriceSource &&priceSource, const IStockApi::MarketInfo &minfo, std::optional<double> init_pos, double balance, bool neg_bal, bool spend, BTTradeOutput &&output) {
 
-			pos = minfo.adjValue(pos, minfo.asset_step, [](auto x){return std::round(x);});
-			bt.size = order.size;
-			bt.price = p;
-			bt.time = price->time;
-			bt.pl = pl;
-			bt.pos = pos;
-			bt.bal = balance+total_spend;
-			bt.unspend_balance= balance;
-			bt.norm_profit_total = bt.norm_profit + bt.norm_accum * p;
-
-
-
-			trades.push_back(bt);
-
-			if (minfo.leverage) {
-				double minbal = std::abs(pos) * p/(2*minfo.leverage);
-				if (balance > minbal) {
-					double rbal1 = balance + pos * (price->pmin-p);
-					double rbal2 = balance + pos * (price->pmax-p);
-					bool trig = false;
-					if (rbal1 <= minbal) {
-						trig = true;
-						bt.price = price->pmin;
-					} else if (rbal2 <= minbal) {
-						trig = true;
-						bt.price = price->pmax;
-					}
-					if (trig) {
-						double df = pos * (bt.price - p);
-						pl += df;
-						balance += df;
-						bt.pos = 0;
-						bt.bal = balance + total_spend;
-						bt.unspend_balance = balance;
-						bt.norm_profit_total = 0;
-						bt.norm_profit = 0;
-						bt.norm_accum = 0;
-						bt.event = BTEvent::liquidation;
-						bt.size = -pos;
-						bt.pl = pl;
-						bt.info = json::object;
-						trades.push_back(bt);
-                        pos = 0;
-					}
+	BTSimulator sim(cfg, minfo, neg_bal, spend, std::move(output));
+	try {
+		std::optional<BTPrice> price = priceSource();
+		if (!price.has_value()) return;
+		if (!sim.start(*price, init_pos, balance)) return;
+		for (price = priceSource();price.has_value();price = priceSource()) {
+			if (!sim.step(*price, balance)) return;
+		}
+	} catch (std::exception &) {
+		if (!sim.anyTrade()) throw;
+	}
+}
 
-				}
-			}
+namespace {
+
+struct PortfolioMember {
+	BTPortfolioTrader &trader;
+	BTTrades &trades;
+	WalletDB::Key key;
+	BTSimulator sim;
+	std::optional<BTPrice> next;
+	bool started = false;
+	bool stopped = false;
+	BTEvent event = BTEvent::no_event;
+
+	PortfolioMember(BTPortfolioTrader &trader, BTTrades &trades, std::size_t uid, bool neg_bal)
+		:trader(trader)
+		,trades(trades)
+		,key{std::string(), trader.wallet, std::string(), uid}
+		,sim(trader.config, trader.minfo, neg_bal, false, [this](const BTTrade &bt){
+			this->trades.push_back(bt);
+			if (event == BTEvent::no_event) event = bt.event;
+			return true;
+		}) {}
+};
 
+}
+
+static void backtest_wallet(std::vector<BTPortfolioTrader> &traders, BTPortfolioResult &res, BTWalletResult &wallet, double balance, bool neg_bal) {
+	WalletDB wdb;
+	std::vector<std::unique_ptr<PortfolioMember> > members;
+	for (std::size_t idx: wallet.traders) {
+		auto m = std::make_unique<PortfolioMember>(traders[idx], res.trades[idx], idx+1, neg_bal);
+		m->next = m->trader.source();
+		//initial balance is divided equally
+		wdb.alloc(WalletDB::Key(m->key), balance/wallet.traders.size());
+		members.push_back(std::move(m));
+	}
+
+	while (true) {
+		std::optional<std::uint64_t> tm;
+		for (const auto &m: members) {
+			if (!m->stopped && m->next.has_value() && (!tm.has_value() || m->next->time < *tm)) tm = m->next->time;
+		}
+		if (!tm.has_value()) break;
+
+		BTEvent event = BTEvent::no_event;
+		for (const auto &m: members) {
+			if (m->stopped || !m->next.has_value() || m->next->time != *tm) continue;
+			double b = wdb.adjBalance(m->key, balance);
+			double b0 = b;
+			m->event = BTEvent::no_event;
+			try {
+				if (m->started) m->sim.step(*m->next, b);
+				else m->sim.start(*m->next, m->trader.init_pos, b);
+			} catch (std::exception &) {
+				if (!m->sim.anyTrade()) throw;
+				m->stopped = true;
+			}
+			m->started = true;
+			balance += b - b0;
+			wdb.alloc(WalletDB::Key(m->key), m->sim.getAllocation());
+			if (event == BTEvent::no_event) event = m->event;
+			m->next = m->trader.source();
 		}
 
-	} catch (std::exception &e) {
-		if (trades.empty()) throw;
-		else {
-			BTTrade bt = trades.back();
-			bt.time+=3600*1000;
-			bt.info = json::Object({{"error", e.what()}});
+		BTWalletState st;
+		st.time = *tm;
+		st.balance = balance;
+		st.equity = balance;
+		st.event = event;
+		st.allocation.reserve(members.size());
+		for (const auto &m: members) {
+			st.equity += m->sim.getPositionValue();
+			st.allocation.push_back(wdb.query(m->key).thisTrader);
 		}
+		wallet.states.push_back(std::move(st));
 	}
+}
 
-	if (minfo.invert_price) {
-		for (auto &&x: trades) {
-			x.neutral_price = 1.0/x.neutral_price;
-			x.open_price = 1.0/x.open_price;
-			x.pos = -x.pos;
-			x.price = 1.0/x.price;
-			x.size = -x.size;
+BTPortfolioResult backtest_portfolio(std::vector<BTPortfolioTrader> &&traders, const BTWalletBalances &balances, bool neg_bal) {
+	BTPortfolioResult res;
+	res.trades.resize(traders.size());
+	for (std::size_t i = 0; i < traders.size(); i++) {
+		auto iter = std::find_if(res.wallets.begin(), res.wallets.end(), [&](const BTWalletResult &w) {
+			return w.wallet == traders[i].wallet;
+		});
+		if (iter == res.wallets.end()) {
+			res.wallets.push_back({traders[i].wallet});
+			iter = std::prev(res.wallets.end());
 		}
+		iter->traders.push_back(i);
 	}
 
-	return trades;
+	//wallets are independent, every wallet is simulated by own thread
+	std::vector<std::future<void> > tasks;
+	for (BTWalletResult &w: res.wallets) {
+		auto b = balances.find(w.wallet);
+		double balance = b == balances.end()?0.0:b->second;
+		tasks.push_back(std::async(std::launch::async, [&traders, &res, &w, balance, neg_bal]{
+			backtest_wallet(traders, res, w, balance, neg_bal);
+		}));
+	}
+	for (auto &t: tasks) t.wait();
+	for (auto &t: tasks) t.get();
+	return res;
+}
+
+BTPriceSource tickTradeSource(const PBTColumns &cols, clone_ptr<ISpreadGen> fn, std::uint64_t start_date, bool swap, bool ifut, bool invert_price, bool warmup) {
+	const std::uint64_t *t = cols->time();
+	const double *bid = cols->bid();
+	const double *ask = cols->ask();
+	std::size_t cnt = cols->size();
+	std::size_t beg = std::lower_bound(t, t+cnt, start_date) - t;
+	ISpreadGen::PState state = fn->start();
+	if (warmup) {
+		std::uint64_t hist = static_cast<std::uint64_t>(fn->get_required_history_length())*60000;
+		std::size_t pos = std::lower_bound(t, t+beg, start_date>hist?start_date-hist:0) - t;
+		while (pos < beg) {
+			std::uint64_t mend = (t[pos]/60000+1)*60000;
+			while (pos+1 < beg && t[pos+1] < mend) ++pos;
+			double wb = bid[pos], wa = ask[pos];
+			if (swap) {
+				double tmp = 1.0/wb;
+				wb = 1.0/wa;
+				wa = tmp;
+			}
+			fn->point(state, ifut?(1.0/wa+1.0/wb)*0.5:(wb+wa)*0.5, false);
+			++pos;
+		}
+	}
+	auto output = [invert_price](std::optional<BTPrice> x) {
+		if (x.has_value() && invert_price) {
+			x->price = 1.0/x->price;
+			double tmp = 1.0/x->pmin;
+			x->pmin = 1.0/x->pmax;
+			x->pmax = tmp;
+		}
+		return x;
+	};
+
+	return [=, cols = cols, pos = beg, minute_end = std::uint64_t(0), mid = 0.0, last = 0.0,
+			orders = ISpreadGen::Result(), pending = std::optional<BTPrice>()]() mutable {
+		while (pos < cnt) {
+			double wb = bid[pos], wa = ask[pos];
+			if (swap) {
+				double tmp = 1.0/wb;
+				wb = 1.0/wa;
+				wa = tmp;
+			}
+			double vb = wb, va = wa;
+			if (ifut) {
+				vb = 1.0/wa;
+				va = 1.0/wb;
+			}
+			std::uint64_t tm = t[pos];
+			++pos;
+			if (tm >= minute_end) {
+				if (minute_end) fn->point(state, mid, false);
+				else last = (vb+va)*0.5;
+				minute_end = (tm/60000+1)*60000;
+				orders = fn->get_result(state, last);
+			}
+			mid = (vb+va)*0.5;
+			double execp;
+			if (orders.buy.has_value() && va <= *orders.buy) {
+				execp = *orders.buy;
+			} else if (orders.sell.has_value() && vb >= *orders.sell) {
+				execp = *orders.sell;
+			} else {
+				if (pending.has_value()) {
+					if (wb < pending->pmin) pending->pmin = wb;
+					if (wa > pending->pmax) pending->pmax = wa;
+				}
+				continue;
+			}
+			fn->point(state, execp, true);
+			last = execp;
+			orders = fn->get_result(state, last);
+			double p = ifut?1.0/execp:execp;
+			std::optional<BTPrice> out = pending;
+			pending = BTPrice{tm, p, std::min(p, wb), std::max(p, wa)};
+			if (out.has_value()) return output(out);
+		}
+		std::optional<BTPrice> out = pending;
+		pending.reset();
+		return output(out);
+	};
 }
@@ -10,8 +10,12 @@
 
 #include <imtjson/value.h>
 #include <functional>
+#include <map>
 #include <optional>
+#include <string>
+#include <vector>
 
+#include "btstore.h"
 #include "mtrader.h"
 
 struct BTPrice {
@@ -51,12 +55,137 @@ struct BTTrade {
 
 using BTPriceSource = std::function<std::optional<BTPrice>()>;
 using BTTrades = std::vector<BTTrade>;
+///Receives trades as they are produced by backtest, returns false to stop backtest
+using BTTradeOutput = std::function<bool(const BTTrade &)>;
+
+///Creates source of executions generated by replaying ticks against orders of the spread generator
+/**
+ * The spread generator receives one point (mid price) per minute. Orders are matched against
+ * every tick - buy order is executed when the ask falls to its price, sell order is executed
+ * when the bid rises to its price. Orders are recalculated only after an execution or at the
+ * beginning of the minute, so other ticks cost just few comparisons.
+ *
+ * Range (pmin, pmax) of every execution contains the lowest bid and the highest ask until
+ * the next execution
+ *
+ * @param cols tick data
+ * @param fn spread generator
+ * @param start_date skip ticks before this date
+ * @param swap swap symbols (1/price)
+ * @param ifut inverted futures - orders are calculated for 1/price
+ * @param invert_price market inverts price
+ * @param warmup initialize the spread generator by the minutes before the start date (last mid
+ * price of every minute, up to get_required_history_length() minutes)
+ * @return price source
+ */
+BTPriceSource tickTradeSource(const PBTColumns &cols, clone_ptr<ISpreadGen> fn, std::uint64_t start_date, bool swap, bool ifut, bool invert_price, bool warmup);
 
 class IStockSelector;
 
 
+///Simulates one trader, prices are processed one by one
+/**
+ * Balance is held by the caller, so it can be shared between more simulators
+ */
+class BTSimulator {
+public:
+	BTSimulator(const MTrader_Config &cfg, const IStockApi::MarketInfo &minfo, bool neg_bal, bool spend, BTTradeOutput &&output);
+
+	///Processes the first price, calculates initial position
+	/**
+	 * @param price first price
+	 * @param init_pos initial position, if not set, it is calculated by the strategy
+	 * @param balance balance available to the trader, it is updated
+	 * @return false if the output requested to stop
+	 */
+	bool start(const BTPrice &price, std::optional<double> init_pos, double &balance);
+	///Processes the next price
+	/**
+	 * @param price next price
+	 * @param balance balance available to the trader, it is updated
+	 * @return false if the output requested to stop
+	 */
+	bool step(const BTPrice &price, double &balance);
+
+	///Currency allocated by the strategy at the last price
+	double getAllocation() const;
+	///Value of the position at the last price (spot market only, 0 for leveraged market)
+	double getPositionValue() const;
+	///Returns true if at least one trade has been produced
+	bool anyTrade() const {return any_trade;}
+
+protected:
+	const MTrader_Config &cfg;
+	IStockApi::MarketInfo minfo;
+	bool neg_bal;
+	bool spend;
+	BTTradeOutput output;
+	Strategy s;
+	BTTrade bt;
+	double pos = 0;
+	double total_spend = 0;
+	double pl = 0;
+	bool any_trade = false;
+
+	bool emit(const BTTrade &bt);
+};
+
 BTTrades backtest_cycle(const MTrader_Config &config, BTPriceSource &&priceSource, const IStockApi::MarketInfo &minfo, std::optional<double> init_pos, double balance, bool negbal, bool spend);
+///Performs backtest, passes every trade to the output as soon as it is produced
+void backtest_cycle(const MTrader_Config &config, BTPriceSource &&priceSource, const IStockApi::MarketInfo &minfo, std::optional<double> init_pos, double balance, bool negbal, bool spend, BTTradeOutput &&output);
 
 
+///Trader of the portfolio backtest
+struct BTPortfolioTrader {
+	MTrader_Config config;
+	IStockApi::MarketInfo minfo;
+	BTPriceSource source;
+	std::optional<double> init_pos;
+	///name of the wallet - traders of the same wallet share the balance
+	std::string wallet;
+};
+
+///State of the wallet after all traders processed prices of the same time
+struct BTWalletState {
+	std::uint64_t time;
+	///currency balance of the wallet
+	double balance;
+	///balance and value of positions (spot markets)
+	double equity;
+	///allocation of the traders (same order as BTWalletResult::traders)
+	std::vector<double> allocation;
+	///first event reported by a trader in this step
+	BTEvent event = BTEvent::no_event;
+};
+
+struct BTWalletResult {
+	std::string wallet;
+	///indexes of traders of the wallet
+	std::vector<std::size_t> traders;
+	std::vector<BTWalletState> states;
+};
+
+struct BTPortfolioResult {
+	///trades of every trader (same order as input)
+	std::vector<BTTrades> trades;
+	std::vector<BTWalletResult> wallets;
+};
+
+///Initial balance of the wallets
+using BTWalletBalances = std::map<std::string, double, std::less<> >;
+
+///Performs backtest of more traders sharing wallets
+/**
+ * Traders of the same wallet are simulated in lockstep, prices are aligned by time. Each trader
+ * receives balance adjusted by allocations of other traders of the wallet (see WalletDB). Wallets
+ * are independent, so they are simulated in parallel
+ *
+ * @param traders list of traders
+ * @param balances initial balance of the wallets. The balance is divided equally between traders
+ * before the first price
+ * @param neg_bal allow negative balance (spot)
+ * @return result
+ */
+BTPortfolioResult backtest_portfolio(std::vector<BTPortfolioTrader> &&traders, const BTWalletBalances &balances, bool neg_bal);
 
 #endif /* SRC_MAIN_BACKTEST_H_ */
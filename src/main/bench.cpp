@@ -0,0 +1,459 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: 18. 10. 2026
+ *
+ *  Benchmark of strategies, spread generators and backtest. Results are written
+ *  to the stdout as JSON, so they can be compared between commits
+ *
+ *  Usage: mmbot_bench [-d <directory with csv files>] [-r <repeat>] [-f <filter>] [-b <broker>] [-t <tick file>]
+ *
+ *  -t tick data file in the format of the backtest tick import (rows or columns). The ticks are
+ *     replayed against the spread generators. A synthetic tick series is always measured
+ *
+ *  -b path to the broker executable. The broker's latency is measured through the pipes and
+ *     in-process (plugin <broker>.so), build with -DBROKER_PLUGINS=ON
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <shared/filesystem.h>
+#include <string>
+#include <vector>
+
+#include <imtjson/array.h>
+#include <imtjson/object.h>
+#include <imtjson/value.h>
+#include "abstractExtern.h"
+#include "backtest.h"
+#include "btstore.h"
+#include "random_chart.h"
+#include "spread.h"
+#include "strategy.h"
+
+using json::Value;
+using json::Object;
+
+struct BenchInput {
+	std::string name;
+	std::vector<double> prices;
+};
+
+struct BenchTicks {
+	std::string name;
+	PBTColumns cols;
+};
+
+struct BenchCtx {
+	std::vector<BenchInput> inputs;
+	std::vector<BenchTicks> ticks;
+	unsigned int repeat = 3;
+	std::string filter;
+	std::string broker;
+	json::Array results;
+};
+
+static const std::pair<const char *, const char *> strategies[] = {
+		{"halfhalf",R"({"type":"halfhalf","ea":0,"accum":0})"},
+		{"keepvalue",R"({"type":"keepvalue","ea":0,"accum":0,"valinc":0})"},
+		{"hypersquare",R"({"type":"hypersquare","ea":0,"accum":0})"},
+		{"errorfn",R"({"type":"errorfn","ea":0,"accum":0})"},
+		{"pile",R"({"type":"pile","accum":0,"ratio":50})"},
+		{"keepvalue2",R"({"type":"keepvalue2","accum":0,"reinvest":false,"boost":false,"chngtm":0})"},
+		{"sinh",R"({"type":"sinh","power":1,"curv":5,"reduction":0})"},
+		{"sinh_val",R"({"type":"sinh_val","power":1,"curv":5,"reduction":0})"},
+		{"gamma",R"({"type":"gamma","function":"halfhalf","exponent":2,"rebalance":1,"trend":0,"reinvest":false})"},
+		{"gamma_keepvalue",R"({"type":"gamma","function":"keepvalue","exponent":2,"rebalance":1,"trend":0,"reinvest":false})"},
+		{"gamma_gauss",R"({"type":"gamma","function":"gauss","exponent":2,"rebalance":1,"trend":0,"reinvest":false})"},
+		{"sinh_gen",R"({"type":"sinh_gen","p":100,"w":20,"b":0,"z":0,"ratio":100,"disableSide":0})"},
+		{"inc_value",R"({"type":"inc_value","r":1,"w":20,"z":1,"ms":0})"},
+		{"sinh2",R"({"type":"sinh2","power":1,"curv":5,"reduction":0})"},
+		{"sinh_leveraged",R"({"type":"sinh","power":1,"curv":5,"reduction":0.125,"powadj":1,"dynred":1,"trend_factor":0.1,"longonly":false})"},
+		{"expwide",R"({"type":"expwide","r":10,"w":100,"z":3,"z2":0,"m":1,"s":0,"dnrdc":false})"},
+		{"keep_balance",R"({"type":"keep_balance","keep_min":0,"keep_max":100})"},
+		{"hedge",R"({"type":"hedge","drop":1,"long":true,"short":true})"},
+		{"hodlshort",R"({"type":"hodlshort","z":1,"b":100,"acc":0,"rinvst":false})"},
+		{"passive_income",R"({"type":"passive_income","exponent":40})"},
+		{"gamma_exponencial",R"({"type":"gamma","function":"exponencial","exponent":2,"rebalance":1,"trend":0,"reinvest":false})"},
+		{"gamma_invsqrtsinh",R"({"type":"gamma","function":"invsqrtsinh","exponent":2,"rebalance":1,"trend":0,"reinvest":false})"},
+		{"conststep",R"({"type":"conststep"})"},
+		{"dcavalue",R"({"type":"dcavalue","max_drop":70})"},
+		{"dcavolume",R"({"type":"dcavolume"})"},
+		{"dcamartingale",R"({"type":"dcamartingale","init_step":1,"exponent":10,"cutoff":1})"},
+		{"dcashitcoin",R"({"type":"dcashitcoin"})"},
+		{"DCAM_powern",R"({"type":"DCAM","fn_type":"powern","initial_budget":0,"initial_yield_mult":1,"multipler":1,"power":25,"yield_mult":0})"},
+		{"DCAM_sinh",R"({"type":"DCAM","fn_type":"sinh","initial_budget":0,"initial_yield_mult":1,"multipler":1,"power":25,"yield_mult":0})"},
+		{"DCAM_volume_sinh",R"({"type":"DCAM","fn_type":"volume_sinh","initial_budget":0,"initial_yield_mult":1,"multipler":1,"power":25,"yield_mult":0})"}
+};
+
+static const std::pair<const char *, const char *> spreads[] = {
+		{"legacy",R"({})"},
+		{"legacy_dynmult",R"({"dynmult_raise":200,"dynmult_fall":2,"dynmult_mode":"independent"})"},
+		{"bollinger",R"({"spread":{"type":"bollinger","interval":24,"deviation":0,"curves":[1,2,3],"zero_curve":false}})"}
+};
+
+///prevents optimizer to remove calculations
+static volatile double bench_sink = 0;
+
+static IStockApi::MarketInfo benchMarketInfo() {
+	IStockApi::MarketInfo minfo;
+	minfo.asset_symbol = "BTC";
+	minfo.currency_symbol = "USD";
+	minfo.asset_step = 0.00000001;
+	minfo.currency_step = 0.01;
+	minfo.min_size = 0;
+	minfo.min_volume = 0;
+	minfo.fees = 0;
+	return minfo;
+}
+
+///Measures function, returns best time in nanoseconds
+template<typename Fn>
+static double measure(unsigned int repeat, Fn &&fn) {
+	double best = 0;
+	for (unsigned int i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		auto end = std::chrono::steady_clock::now();
+		double d = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		if (i == 0 || d < best) best = d;
+	}
+	return best;
+}
+
+template<typename Fn>
+static void runBench(BenchCtx &ctx, const std::string &name, const BenchInput &input, std::size_t ops, Fn &&fn) {
+	if (!ctx.filter.empty() && name.find(ctx.filter) == name.npos) return;
+	Object rec;
+	rec.set("name", name);
+	rec.set("input", input.name);
+	rec.set("ops", ops);
+	try {
+		double ns = measure(ctx.repeat, fn);
+		rec.set("total_ms", ns/1000000.0);
+		rec.set("ns_per_op", ops?ns/ops:0.0);
+	} catch (std::exception &e) {
+		rec.set("error", e.what());
+	}
+	std::cerr << name << " (" << input.name << "): " << Value(rec).toString().str() << std::endl;
+	ctx.results.push_back(rec);
+}
+
+static Strategy initStrategy(const Strategy &st, const IStockApi::MarketInfo &minfo, double price, double &assets, double &currency) {
+	Strategy s = st;
+	assets = 1.0;
+	currency = price;
+	s.onIdle(minfo, IStockApi::Ticker{price, price, price, 0}, assets, currency);
+	return s;
+}
+
+static void benchStrategies(BenchCtx &ctx) {
+	auto minfo = benchMarketInfo();
+	for (const auto &def: strategies) {
+		Value cfg = Value::fromString(def.second);
+		std::optional<Strategy> stopt;
+		try {
+			stopt.emplace(Strategy::create(cfg["type"].getString(), cfg));
+		} catch (std::exception &e) {
+			std::cerr << "Strategy " << def.first << " skipped: " << e.what() << std::endl;
+			continue;
+		}
+		const Strategy &st = *stopt;
+		std::string prefix = std::string("strategy/")+def.first;
+		for (const auto &input: ctx.inputs) {
+			const auto &prices = input.prices;
+			if (prices.size() < 2) continue;
+
+			//prepare list of trades (untimed), replayed by onTrade benchmark
+			struct Trade {double price; double size; double assets; double currency;};
+			std::vector<Trade> trades;
+			try {
+				double assets, currency;
+				Strategy s = initStrategy(st, minfo, prices[0], assets, currency);
+				double last = prices[0];
+				for (double p: prices) {
+					if (p == last) continue;
+					auto order = s.getNewOrder(minfo, last, p, p>last?-1:1, assets, currency, false);
+					double sz = order.size;
+					if (!std::isfinite(sz) || sz == 0) continue;
+					if (sz < 0 && -sz > assets) sz = -assets;
+					if (sz > 0 && sz*p > currency) sz = currency/p;
+					assets += sz;
+					currency -= sz*p;
+					trades.push_back({p, sz, assets, currency});
+					s.onTrade(minfo, p, sz, assets, currency);
+					last = p;
+				}
+			} catch (...) {
+				//strategy is unable to trade this input, onTrade is not measured
+				trades.clear();
+			}
+
+			runBench(ctx, prefix+"/getNewOrder", input, prices.size()*2, [&]{
+				double assets, currency;
+				Strategy s = initStrategy(st, minfo, prices[0], assets, currency);
+				double last = prices[0];
+				double sum = 0;
+				for (double p: prices) {
+					sum += s.getNewOrder(minfo, last, p*1.01, -1, assets, currency, false).size;
+					sum += s.getNewOrder(minfo, last, p*0.99, 1, assets, currency, false).size;
+					last = p;
+				}
+				bench_sink = sum;
+			});
+			if (!trades.empty()) {
+				runBench(ctx, prefix+"/onTrade", input, trades.size(), [&]{
+					double assets, currency;
+					Strategy s = initStrategy(st, minfo, prices[0], assets, currency);
+					for (const Trade &t: trades) {
+						s.onTrade(minfo, t.price, t.size, t.assets, t.currency);
+					}
+				});
+			}
+			runBench(ctx, prefix+"/calcChart", input, prices.size(), [&]{
+				double assets, currency;
+				Strategy s = initStrategy(st, minfo, prices[0], assets, currency);
+				double sum = 0;
+				for (double p: prices) {
+					auto pt = s.calcChart(p);
+					sum += pt.position;
+				}
+				bench_sink = sum;
+			});
+			//1000 points grid around the first price (as the chart in the web admin)
+			std::vector<double> grid(1000);
+			for (std::size_t i = 0; i < grid.size(); i++) grid[i] = prices[0]*(0.5+i/1000.0);
+			runBench(ctx, prefix+"/calcChartBatch", input, grid.size(), [&]{
+				double assets, currency;
+				Strategy s = initStrategy(st, minfo, prices[0], assets, currency);
+				auto pts = s.calcChartBatch(grid);
+				bench_sink = pts.back().position;
+			});
+		}
+	}
+}
+
+static void benchSpreads(BenchCtx &ctx) {
+	for (const auto &def: spreads) {
+		auto gen = create_spread_generator(Value::fromString(def.second));
+		std::string prefix = std::string("spread/")+def.first;
+		for (const auto &input: ctx.inputs) {
+			const auto &prices = input.prices;
+			runBench(ctx, prefix+"/point", input, prices.size(), [&]{
+				auto state = gen->start();
+				for (double p: prices) gen->point(state, p, false);
+			});
+			runBench(ctx, prefix+"/get_result", input, prices.size(), [&]{
+				auto state = gen->start();
+				double sum = 0;
+				for (double p: prices) {
+					gen->point(state, p, false);
+					auto r = gen->get_result(state, p);
+					sum += r.buy.value_or(0) + r.sell.value_or(0);
+				}
+				bench_sink = sum;
+			});
+		}
+	}
+}
+
+static void benchBacktest(BenchCtx &ctx) {
+	auto minfo = benchMarketInfo();
+	for (const auto &def: strategies) {
+		MTrader_Config cfg;
+		try {
+			cfg.loadConfig(Object({
+				{"strategy", Value::fromString(def.second)},
+				{"enabled", true}
+			}));
+		} catch (std::exception &e) {
+			std::cerr << "Backtest " << def.first << " skipped: " << e.what() << std::endl;
+			continue;
+		}
+		std::string name = std::string("backtest/")+def.first;
+		for (const auto &input: ctx.inputs) {
+			const auto &prices = input.prices;
+			if (prices.empty()) continue;
+			runBench(ctx, name, input, prices.size(), [&]{
+				std::size_t pos = 0;
+				backtest_cycle(cfg, [&]{
+					std::optional<BTPrice> r;
+					if (pos < prices.size()) {
+						double p = prices[pos];
+						r = BTPrice{pos*60000, p, p, p};
+						++pos;
+					}
+					return r;
+				}, minfo, std::optional<double>(), prices[0]*2, false, false);
+			});
+		}
+	}
+}
+
+///Replays ticks against the orders of the spread generators, ops is count of ticks
+static void benchTicks(BenchCtx &ctx) {
+	for (const auto &def: spreads) {
+		auto gen = create_spread_generator(Value::fromString(def.second));
+		std::string name = std::string("ticks/")+def.first+"/replay";
+		for (const auto &t: ctx.ticks) {
+			BenchInput input;
+			input.name = t.name;
+			runBench(ctx, name, input, t.cols->size(), [&]{
+				BTPriceSource src = tickTradeSource(t.cols, gen, 0, false, false, false, false);
+				std::size_t execs = 0;
+				while (src().has_value()) ++execs;
+				bench_sink = execs;
+			});
+		}
+	}
+}
+
+///Generates ticks around the prices of a random chart, every minute contains 'per_minute' ticks
+static BenchTicks generateTicks(unsigned int minutes, unsigned int per_minute) {
+	struct Row {
+		std::uint64_t time;
+		double bid;
+		double ask;
+	};
+	std::vector<double> prices;
+	generate_random_chart(0.001, 0, minutes+1, 2, prices);
+	std::vector<Row> rows;
+	rows.reserve(static_cast<std::size_t>(minutes)*per_minute);
+	std::uint32_t rnd = 1;
+	for (unsigned int m = 0; m < minutes; m++) {
+		double p0 = prices[m];
+		double p1 = prices[m+1];
+		for (unsigned int i = 0; i < per_minute; i++) {
+			rnd = rnd * 1664525 + 1013904223;
+			double noise = (static_cast<double>(rnd >> 8) / (1<<24) - 0.5) * 0.0002;
+			double mid = (p0 + (p1 - p0) * i / per_minute) * (1.0 + noise);
+			std::uint64_t tm = static_cast<std::uint64_t>(m)*60000 + static_cast<std::uint64_t>(i)*60000/per_minute;
+			rows.push_back({tm, mid*0.99995, mid*1.00005});
+		}
+	}
+	BenchTicks r;
+	r.name = "random_ticks_"+std::to_string(rows.size());
+	r.cols = BTColumns::create_ticks(rows.data(), rows.size()*sizeof(Row));
+	return r;
+}
+
+class BenchExtern: public AbstractExtern {
+public:
+	using AbstractExtern::AbstractExtern;
+	virtual void onConnect() override {
+		//same negotiation as ExtStockApi
+		try {
+			jsonRequestExchange("bin", Value());
+			binary_mode = true;
+		} catch (...) {
+			//empty
+		}
+	}
+	bool isPlugin() const {return plugin != nullptr;}
+};
+
+///Compares latency of a call through the pipes (subprocess) and direct call (plugin)
+static void benchBroker(BenchCtx &ctx) {
+	if (ctx.broker.empty()) return;
+	static const std::pair<const char *, const char *> transports[] = {
+			{"subprocess",""},
+			{"plugin",".so"}
+	};
+	std::string storage = (std::filesystem::temp_directory_path()/"mmbot_bench_broker").string();
+	BenchInput input;
+	input.name = std::filesystem::path(ctx.broker).filename().string();
+	const unsigned int calls = 10000;
+	for (const auto &t: transports) {
+		std::string name = std::string("broker/")+t.first+"/getApiKeyFields";
+		if (!ctx.filter.empty() && name.find(ctx.filter) == name.npos) continue;
+		std::string cmdline = "\""+ctx.broker+t.second+"\" \""+storage+"\"";
+		BenchExtern ext(std::filesystem::current_path().string(), t.first, cmdline, 10000);
+		try {
+			//first call starts the broker
+			ext.jsonRequestExchange("getApiKeyFields", Value());
+		} catch (std::exception &e) {
+			std::cerr << name << " skipped: " << e.what() << std::endl;
+			continue;
+		}
+		if (ext.isPlugin() != (*t.second != 0)) {
+			std::cerr << name << " skipped: plugin is not available" << std::endl;
+			continue;
+		}
+		runBench(ctx, name, input, calls, [&]{
+			for (unsigned int i = 0; i < calls; i++) ext.jsonRequestExchange("getApiKeyFields", Value());
+		});
+	}
+}
+
+static BenchInput loadCSV(const std::filesystem::path &fname) {
+	BenchInput r;
+	r.name = fname.filename().string();
+	std::ifstream f(fname);
+	std::string line;
+	while (std::getline(f, line)) {
+		auto sep = line.rfind(',');
+		if (sep == line.npos) continue;
+		double p = std::strtod(line.c_str()+sep+1, nullptr);
+		if (p > 0) r.prices.push_back(p);
+	}
+	return r;
+}
+
+int main(int argc, char **argv) {
+	BenchCtx ctx;
+	std::string dir = "backtest";
+	std::string tickfile;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i],"-d") == 0 && i+1 < argc) dir = argv[++i];
+		else if (std::strcmp(argv[i],"-r") == 0 && i+1 < argc) ctx.repeat = std::max(1,std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i],"-f") == 0 && i+1 < argc) ctx.filter = argv[++i];
+		else if (std::strcmp(argv[i],"-b") == 0 && i+1 < argc) ctx.broker = argv[++i];
+		else if (std::strcmp(argv[i],"-t") == 0 && i+1 < argc) tickfile = argv[++i];
+		else {
+			std::cerr << "Usage: " << argv[0] << " [-d <directory with csv files>] [-r <repeat>] [-f <filter>] [-b <broker>] [-t <tick file>]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::error_code ec;
+	for (const auto &entry: std::filesystem::directory_iterator(dir, ec)) {
+		if (entry.path().extension() == ".csv") ctx.inputs.push_back(loadCSV(entry.path()));
+	}
+	std::sort(ctx.inputs.begin(), ctx.inputs.end(), [](const BenchInput &a, const BenchInput &b){
+		return a.name < b.name;
+	});
+	if (ctx.inputs.empty()) std::cerr << "No csv files found in: " << dir << std::endl;
+	{
+		BenchInput rnd;
+		rnd.name = "random_525600";
+		generate_random_chart(0.001, 0, 525600, 1, rnd.prices);
+		ctx.inputs.push_back(std::move(rnd));
+	}
+	if (!tickfile.empty()) {
+		BenchTicks t;
+		t.name = std::filesystem::path(tickfile).filename().string();
+		t.cols = BacktestStorage::import_ticks(tickfile);
+		if (t.cols == nullptr) std::cerr << "Invalid tick data: " << tickfile << std::endl;
+		else ctx.ticks.push_back(std::move(t));
+	}
+	//one week, a tick every second
+	ctx.ticks.push_back(generateTicks(10080, 60));
+
+	benchStrategies(ctx);
+	benchSpreads(ctx);
+	benchBacktest(ctx);
+	benchTicks(ctx);
+	benchBroker(ctx);
+
+	Object out;
+	out.set("repeat", ctx.repeat);
+	out.set("results", ctx.results);
+	Value(out).toStream(std::cout);
+	std::cout << std::endl;
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * brokerplugin.h
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#ifndef SRC_MAIN_BROKERPLUGIN_H_
+#define SRC_MAIN_BROKERPLUGIN_H_
+
+#include <cstddef>
+
+///Entry points of the broker built as shared library (plugin)
+/**
+ * The plugin is loaded into the mmbot process, so requests are not passed through the pipes.
+ * Both sides have own copy of the imtjson library, so the requests and the responses are
+ * passed as serialized binary json. The content is same as in the subprocess mode. Request
+ * is [name, args], response is [true, result] or [false, error]
+ *
+ * The library is loaded once per process and it is never unloaded, so its static and global
+ * state outlives the instance. Only one instance per library is opened in the process at a
+ * time, other brokers of the same library run as subprocesses. An instance must
+ * still keep all its state in the object returned by the open function, because the next
+ * instance (after the broker is restarted) gets the same image of the library
+ */
+extern "C" {
+
+///Receives data from the plugin
+typedef void (*MMBotPluginWriteFn)(void *ctx, const char *data, std::size_t size);
+///Creates instance of the broker
+/**
+ * @param secure_storage_path path to the storage of the api keys (first argument in the subprocess mode)
+ * @param log function receives lines of log messages
+ * @param ctx context passed to the log function
+ * @return handle of the instance
+ */
+typedef void *(*MMBotPluginOpenFn)(const char *secure_storage_path, MMBotPluginWriteFn log, void *ctx);
+///Calls the method
+/**
+ * @param handle handle of the instance
+ * @param request serialized request
+ * @param size size of the request
+ * @param response function receives serialized response
+ * @param ctx context passed to the response function
+ */
+typedef void (*MMBotPluginCallFn)(void *handle, const char *request, std::size_t size, MMBotPluginWriteFn response, void *ctx);
+///Destroys instance of the broker
+typedef void (*MMBotPluginCloseFn)(void *handle);
+
+}
+
+#define MMBOT_PLUGIN_OPEN "mmbot_broker_open"
+#define MMBOT_PLUGIN_CALL "mmbot_broker_call"
+#define MMBOT_PLUGIN_CLOSE "mmbot_broker_close"
+
+#endif /* SRC_MAIN_BROKERPLUGIN_H_ */
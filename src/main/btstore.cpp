@@ -5,11 +5,19 @@
  *      Author: ondra
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <shared/filesystem.h>
 #include "btstore.h"
+#include "backtest.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <vector>
 
@@ -34,6 +42,7 @@ void BacktestStorage::cleanup() {
 	} else {
 		in_memory_files.clear();
 	}
+	columns.clear();
 }
 
 std::vector<BacktestStorage::Metadata>::const_iterator BacktestStorage::find(const std::string &id) const {
@@ -79,6 +88,7 @@ void BacktestStorage::add_metadata(const Metadata &md) {
 void BacktestStorage::remove_metadata(const std::vector<Metadata>::const_iterator &iter) {
 	auto p = iter->fpath;
 	meta.erase(iter);
+	columns.erase(p);
 	if (in_memory) {
 		in_memory_files.erase(p);
 	} else {
@@ -86,19 +96,23 @@ void BacktestStorage::remove_metadata(const std::vector<Metadata>::const_iterato
 	}
 }
 
+std::string BacktestStorage::temp_path(const std::string &id) const {
+	auto tmpPath = std::filesystem::temp_directory_path();
+	std::string pid = std::to_string(getpid());
+	return (tmpPath / ("mmbot_backtest_"+pid+"x"+id)).string();
+}
+
 void BacktestStorage::store_data(const json::Value &data, const std::string &id) {
 	if (in_memory) {
 		in_memory_files[id] =  data;
 		add_metadata({id,id,std::chrono::system_clock::now()});
 	} else {
-		auto tmpPath = std::filesystem::temp_directory_path();
-		std::string pid = std::to_string(getpid());
-		auto fpath = tmpPath / ("mmbot_backtest_"+pid+"x"+id);
+		auto fpath = temp_path(id);
 		std::ofstream f(fpath, std::ios::binary);
 		if (!(!f)) {
 			data.serializeBinary([&](char c){f.put(c);}, json::compressKeys);
 			if (!(!f)) {
-				add_metadata({id,fpath.string(),std::chrono::system_clock::now()});
+				add_metadata({id,fpath,std::chrono::system_clock::now()});
 				return;
 			}
 		}
@@ -118,6 +132,15 @@ std::string BacktestStorage::store_data(const json::Value &data) {
 json::Value BacktestStorage::load_data(const std::string &id) {
 	auto iter = find(id);
 	if (iter == meta.end()) return json::Value();
+	if (iter->columnar) {
+		auto c = columns.find(iter->fpath);
+		if (c == columns.end()) {
+			remove_metadata(iter);
+			return json::Value();
+		}
+		mark_access(iter);
+		return c->second->toJSON();
+	}
 	if (in_memory) {
 		mark_access(iter);
 		return in_memory_files[iter->fpath];
@@ -142,3 +165,294 @@ void BacktestStorage::mark_access(const std::vector<Metadata>::const_iterator &i
 	myiter->lastAccess = std::chrono::system_clock::now();
 
 }
+
+void BacktestStorage::store_data(const PBTColumns &data, const std::string &id) {
+	//never overwrite existing file, it can be still mapped by a reader
+	auto iter = find(id);
+	if (iter != meta.end()) remove_metadata(iter);
+	if (in_memory) {
+		columns[id] = data;
+		add_metadata({id,id,std::chrono::system_clock::now(),true});
+	} else {
+		auto fpath = temp_path(id);
+		if (data->save(fpath)) {
+			//map stored file, so memory can be released
+			auto mp = BTColumns::map_file(fpath);
+			if (mp != nullptr) {
+				columns[fpath] = mp;
+				add_metadata({id,fpath,std::chrono::system_clock::now(),true});
+				return;
+			}
+		}
+		std::filesystem::remove(fpath);
+		throw std::runtime_error("Inaccessible temporary storage");
+	}
+}
+
+std::string BacktestStorage::store_data(const PBTColumns &data) {
+	std::string id = std::to_string(data->hash());
+	store_data(data, id);
+	return id;
+}
+
+PBTColumns BacktestStorage::load_columns(const std::string &id) {
+	auto iter = find(id);
+	if (iter == meta.end()) return nullptr;
+	if (iter->columnar) {
+		auto c = columns.find(iter->fpath);
+		if (c == columns.end()) {
+			remove_metadata(iter);
+			return nullptr;
+		}
+		mark_access(iter);
+		return c->second;
+	}
+	json::Value v = load_data(id);
+	if (!v.defined()) return nullptr;
+	return BTColumns::create(v);
+}
+
+PBTColumns BacktestStorage::import_ticks(const std::string &fname) {
+	static std::atomic<unsigned int> counter = 0;
+	auto tmpPath = std::filesystem::temp_directory_path();
+	std::string name = "mmbot_import_"+std::to_string(getpid())+"x"+std::to_string(++counter);
+	return BTColumns::import_ticks(fname, (tmpPath / name).string());
+}
+
+static const char btcolumns_magic[8] = {'M','M','B','T','C','O','L','1'};
+
+BTColumns::~BTColumns() {
+	if (mapped) munmap(mapped, total_size);
+}
+
+std::size_t BTColumns::calc_size(Type type, std::size_t count) {
+	std::size_t cols = type == prices?4:type == ticks?3:1;
+	return sizeof(Header)+cols*count*sizeof(double);
+}
+
+std::shared_ptr<BTColumns> BTColumns::alloc(Type type, std::size_t count) {
+	std::shared_ptr<BTColumns> out(new BTColumns);
+	out->total_size = calc_size(type, count);
+	out->buffer.resize((out->total_size+sizeof(std::uint64_t)-1)/sizeof(std::uint64_t));
+	Header *h = reinterpret_cast<Header *>(out->buffer.data());
+	std::memcpy(h->magic, btcolumns_magic, sizeof(h->magic));
+	h->type = type;
+	h->reserved = 0;
+	h->count = count;
+	h->reserved2 = 0;
+	out->hdr = h;
+	return out;
+}
+
+PBTColumns BTColumns::create(const std::vector<double> &minute) {
+	auto out = alloc(BTColumns::minute, minute.size());
+	std::copy(minute.begin(), minute.end(), const_cast<double *>(out->price()));
+	return out;
+}
+
+PBTColumns BTColumns::create(const std::vector<BTPrice> &data) {
+	auto out = alloc(BTColumns::prices, data.size());
+	auto t = const_cast<std::uint64_t *>(out->time());
+	auto p = const_cast<double *>(out->price());
+	auto pmin = const_cast<double *>(out->pmin());
+	auto pmax = const_cast<double *>(out->pmax());
+	for (const BTPrice &x: data) {
+		*t++ = x.time;
+		*p++ = x.price;
+		*pmin++ = x.pmin;
+		*pmax++ = x.pmax;
+	}
+	return out;
+}
+
+PBTColumns BTColumns::create(const json::Value &data) {
+	if (data[0].type() == json::array) {
+		std::vector<BTPrice> out;
+		out.reserve(data.size());
+		for (json::Value x: data) {
+			if (x.type() != json::array) continue;
+			json::Value r = x[2];
+			bool hasr = r.type() == json::array;
+			double p = x[1].getNumber();
+			double pmin = hasr?r[0].getNumber():p;
+			double pmax = hasr?r[1].getNumber():p;
+			out.push_back({x[0].getUIntLong(), p, pmin,pmax});
+		}
+		return create(out);
+	} else {
+		std::vector<double> out;
+		out.reserve(data.size());
+		for (json::Value x: data) out.push_back(x.getNumber());
+		return create(out);
+	}
+}
+
+///Row of the tick data as uploaded
+struct TickRow {
+	std::uint64_t time;
+	double bid;
+	double ask;
+};
+
+///Converts rows to columns, returns false if rows are not ordered by time
+static bool ticks_rows_to_columns(const void *rows, std::size_t cnt, std::uint64_t *t, double *bid, double *ask) {
+	const unsigned char *src = reinterpret_cast<const unsigned char *>(rows);
+	std::uint64_t prev = 0;
+	for (std::size_t i = 0; i < cnt; i++) {
+		TickRow r;
+		std::memcpy(&r, src + i * sizeof(TickRow), sizeof(TickRow));
+		if (r.time < prev) return false;
+		prev = r.time;
+		t[i] = r.time;
+		bid[i] = r.bid;
+		ask[i] = r.ask;
+	}
+	return true;
+}
+
+PBTColumns BTColumns::create_ticks(const void *data, std::size_t size) {
+	const Header *h = reinterpret_cast<const Header *>(data);
+	std::shared_ptr<BTColumns> out;
+	if (size >= sizeof(Header) && std::memcmp(h->magic, btcolumns_magic, sizeof(btcolumns_magic)) == 0) {
+		if (h->type != ticks || calc_size(ticks, h->count) != size) return nullptr;
+		out = alloc(ticks, h->count);
+		std::memcpy(const_cast<Header *>(out->hdr), data, size);
+		if (!std::is_sorted(out->time(), out->time()+out->size())) return nullptr;
+	} else {
+		if (size % sizeof(TickRow)) return nullptr;
+		std::size_t cnt = size / sizeof(TickRow);
+		out = alloc(ticks, cnt);
+		if (!ticks_rows_to_columns(data, cnt,
+				const_cast<std::uint64_t *>(out->time()),
+				const_cast<double *>(out->bid()),
+				const_cast<double *>(out->ask()))) return nullptr;
+	}
+	return out;
+}
+
+PBTColumns BTColumns::import_ticks(const std::string &fname, const std::string &tmpname) {
+	PBTColumns img = map_file(fname);
+	if (img != nullptr) {
+		if (img->type() != ticks || !std::is_sorted(img->time(), img->time()+img->size())) return nullptr;
+		return img;
+	}
+	int fd = ::open(fname.c_str(), O_RDONLY|O_CLOEXEC);
+	if (fd < 0) return nullptr;
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size == 0 || st.st_size % sizeof(TickRow)) {
+		::close(fd);
+		return nullptr;
+	}
+	std::size_t src_size = st.st_size;
+	std::size_t cnt = src_size / sizeof(TickRow);
+	void *src = mmap(nullptr, src_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (src == MAP_FAILED) return nullptr;
+	madvise(src, src_size, MADV_SEQUENTIAL);
+	//columns are written directly to the target file, so the data are never held in the heap
+	std::size_t trg_size = calc_size(ticks, cnt);
+	bool ok = false;
+	fd = ::open(tmpname.c_str(), O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+	if (fd >= 0) {
+		if (ftruncate(fd, trg_size) == 0) {
+			void *trg = mmap(nullptr, trg_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+			if (trg != MAP_FAILED) {
+				Header *h = reinterpret_cast<Header *>(trg);
+				std::memcpy(h->magic, btcolumns_magic, sizeof(h->magic));
+				h->type = ticks;
+				h->reserved = 0;
+				h->count = cnt;
+				h->reserved2 = 0;
+				std::uint64_t *t = reinterpret_cast<std::uint64_t *>(h+1);
+				double *bid = reinterpret_cast<double *>(t+cnt);
+				ok = ticks_rows_to_columns(src, cnt, t, bid, bid+cnt);
+				munmap(trg, trg_size);
+			}
+		}
+		::close(fd);
+	}
+	munmap(src, src_size);
+	PBTColumns out = ok?map_file(tmpname):nullptr;
+	//mapping stays valid after the file is removed
+	::unlink(tmpname.c_str());
+	return out;
+}
+
+PBTColumns BTColumns::map_file(const std::string &fname) {
+	int fd = ::open(fname.c_str(), O_RDONLY|O_CLOEXEC);
+	if (fd < 0) return nullptr;
+	struct stat st;
+	if (fstat(fd, &st) || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+		::close(fd);
+		return nullptr;
+	}
+	std::size_t sz = st.st_size;
+	void *m = mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (m == MAP_FAILED) return nullptr;
+	std::shared_ptr<BTColumns> out(new BTColumns);
+	out->mapped = m;
+	out->total_size = sz;
+	out->hdr = reinterpret_cast<const Header *>(m);
+	if (std::memcmp(out->hdr->magic, btcolumns_magic, sizeof(btcolumns_magic)) != 0
+		|| (out->hdr->type != minute && out->hdr->type != prices && out->hdr->type != ticks)
+		|| calc_size(out->hdr->type, out->hdr->count) != sz) return nullptr;
+	madvise(m, sz, MADV_SEQUENTIAL);
+	return out;
+}
+
+bool BTColumns::save(const std::string &fname) const {
+	std::ofstream f(fname, std::ios::binary|std::ios::trunc);
+	if (!f) return false;
+	f.write(reinterpret_cast<const char *>(hdr), total_size);
+	f.close();
+	return !(!f);
+}
+
+BTPrice BTColumns::operator[](std::size_t idx) const {
+	if (hdr->type == prices) {
+		return BTPrice{time()[idx], price()[idx], pmin()[idx], pmax()[idx]};
+	} else if (hdr->type == ticks) {
+		double b = bid()[idx], a = ask()[idx];
+		return BTPrice{time()[idx], (b+a)*0.5, b, a};
+	} else {
+		double p = price()[idx];
+		return BTPrice{idx*60000, p, p, p};
+	}
+}
+
+json::Value BTColumns::toJSON() const {
+	json::Array out;
+	std::size_t cnt = size();
+	out.reserve(cnt);
+	if (hdr->type == prices) {
+		auto t = time();
+		auto p = price();
+		auto pmin = this->pmin();
+		auto pmax = this->pmax();
+		for (std::size_t i = 0; i < cnt; i++) {
+			json::Value row {t[i], p[i], json::Value{pmin[i], pmax[i]}};
+			out.push_back(row);
+		}
+	} else if (hdr->type == ticks) {
+		//same format as prices, range contains bid and ask
+		auto t = time();
+		auto bid = this->bid();
+		auto ask = this->ask();
+		for (std::size_t i = 0; i < cnt; i++) {
+			json::Value row {t[i], (bid[i]+ask[i])*0.5, json::Value{bid[i], ask[i]}};
+			out.push_back(row);
+		}
+	} else {
+		auto p = price();
+		for (std::size_t i = 0; i < cnt; i++) {
+			out.push_back(p[i]);
+		}
+	}
+	return out;
+}
+
+std::size_t BTColumns::hash() const {
+	std::hash<std::string_view> h;
+	return h(std::string_view(reinterpret_cast<const char *>(hdr), total_size));
+}
@@ -8,11 +8,124 @@
 #ifndef SRC_MAIN_BTSTORE_H_
 #define SRC_MAIN_BTSTORE_H_
 #include <chrono>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <imtjson/value.h>
 
+struct BTPrice;
+
+///Typed columnar price data
+/**
+ * Data are stored in a single contiguous block, which starts by a small header followed by
+ * columns. Minute data have one column (price), price series (trades) have four columns
+ * (time, price, pmin, pmax), tick data have three columns (time, bid, ask). The block is either owned or memory mapped from a file, so
+ * loading of the stored data requires no conversion
+ */
+class BTColumns {
+public:
+
+	enum Type: std::uint32_t {
+		///one price per minute, no time column
+		minute = 1,
+		///price series with time, price, pmin and pmax
+		prices = 2,
+		///tick data with time, bid and ask
+		ticks = 3
+	};
+
+	BTColumns(const BTColumns &) = delete;
+	BTColumns &operator=(const BTColumns &) = delete;
+	~BTColumns();
+
+	///Create minute data
+	static std::shared_ptr<const BTColumns> create(const std::vector<double> &minute);
+	///Create price series
+	static std::shared_ptr<const BTColumns> create(const std::vector<BTPrice> &prices);
+	///Convert json data (array of numbers or array of [time, price, [pmin, pmax]])
+	static std::shared_ptr<const BTColumns> create(const json::Value &data);
+	///Create tick data from binary data
+	/**
+	 * @param data either complete image of the tick columns (as saved by save()), or rows of
+	 * 24 bytes: time (uint64, milliseconds), bid (double), ask (double). Rows must be ordered by time
+	 * @param size size of the data in bytes
+	 * @return tick data, or nullptr if the data are invalid
+	 */
+	static std::shared_ptr<const BTColumns> create_ticks(const void *data, std::size_t size);
+	///Import tick data from a file
+	/**
+	 * The file is converted without loading it to the memory
+	 *
+	 * @param fname name of the file. It contains either complete image of the tick columns, which
+	 * is mapped directly, or rows in the same format as for create_ticks()
+	 * @param tmpname name of the temporary file which receives converted rows. The file is
+	 * removed, the result stays mapped
+	 * @return tick data, or nullptr, if the file is not accessible or the data are invalid
+	 */
+	static std::shared_ptr<const BTColumns> import_ticks(const std::string &fname, const std::string &tmpname);
+	///Map file to the memory
+	/**
+	 * @param fname name of the file
+	 * @return mapped data, or nullptr, when file is not accessible or has invalid format
+	 */
+	static std::shared_ptr<const BTColumns> map_file(const std::string &fname);
+
+	///Save data to a file
+	bool save(const std::string &fname) const;
+
+	Type type() const {return hdr->type;}
+	std::size_t size() const {return hdr->count;}
+	bool empty() const {return hdr->count == 0;}
+
+	///Time column (prices and ticks only)
+	const std::uint64_t *time() const {return reinterpret_cast<const std::uint64_t *>(hdr+1);}
+	///Price column - for minute data, this is the only column
+	const double *price() const {
+		return reinterpret_cast<const double *>(hdr+1)+(hdr->type != minute?hdr->count:0);
+	}
+	///Bid column (ticks only)
+	const double *bid() const {return price();}
+	///Ask column (ticks only)
+	const double *ask() const {return price()+hdr->count;}
+	///Minimal price column (prices only)
+	const double *pmin() const {return price()+hdr->count;}
+	///Maximal price column (prices only)
+	const double *pmax() const {return pmin()+hdr->count;}
+
+	///Retrieve row as BTPrice
+	BTPrice operator[](std::size_t idx) const;
+
+	///Convert to the json format (for download)
+	json::Value toJSON() const;
+	///Computes hash of the content
+	std::size_t hash() const;
+
+protected:
+
+	struct Header {
+		char magic[8];
+		Type type;
+		std::uint32_t reserved;
+		std::uint64_t count;
+		std::uint64_t reserved2;
+	};
+
+	BTColumns() = default;
+
+	static std::size_t calc_size(Type type, std::size_t count);
+	static std::shared_ptr<BTColumns> alloc(Type type, std::size_t count);
+
+	const Header *hdr = nullptr;
+	std::size_t total_size = 0;
+	///owned buffer (uint64_t for alignment)
+	std::vector<std::uint64_t> buffer;
+	///mapped region
+	void *mapped = nullptr;
+};
+
+using PBTColumns = std::shared_ptr<const BTColumns>;
 
 
 class BacktestStorage {
@@ -25,6 +138,23 @@ public:
 	json::Value load_data(const std::string &id);
 	void store_data(const json::Value &data, const std::string &id);
 
+	///Store columnar data
+	std::string store_data(const PBTColumns &data);
+	///Store columnar data under given id
+	void store_data(const PBTColumns &data, const std::string &id);
+	///Load data as columns
+	/**
+	 * @param id id of data
+	 * @return columnar data. Data stored as json are converted. Returns nullptr, if not found
+	 */
+	PBTColumns load_columns(const std::string &id);
+	///Import tick data from a file (see BTColumns::import_ticks)
+	/**
+	 * Function doesn't access the storage, so it can be called without the lock. Use
+	 * store_data() to store the result
+	 */
+	static PBTColumns import_ticks(const std::string &fname);
+
 
 protected:
 	std::size_t max_files;
@@ -34,6 +164,7 @@ protected:
 		std::string id;
 		std::string fpath;
 		std::chrono::system_clock::time_point lastAccess;
+		bool columnar = false;
 	};
 
 
@@ -44,10 +175,13 @@ protected:
 	std::vector<Metadata>::const_iterator find_to_remove() const;
 
 	std::map<std::string, json::Value, std::less<> > in_memory_files;
+	///columnar data - owned in memory or mapped from the file
+	std::map<std::string, PBTColumns, std::less<> > columns;
 
 	void add_metadata(const Metadata &md);
 	void remove_metadata(const std::vector<Metadata>::const_iterator &iter);
 	void mark_access(const std::vector<Metadata>::const_iterator &iter);
+	std::string temp_path(const std::string &id) const;
 
 
 };
@@ -16,6 +16,8 @@
 #include <set>
 
 #include "../shared/trailer.h"
+#include "histcache.h"
+#include "packeddata.h"
 using namespace ondra_shared;
 
 
@@ -34,22 +36,18 @@ double ExtStockApi::getBalance(const std::string_view & symb, const std::string_
 }
 
 
-ExtStockApi::TradesSync ExtStockApi::syncTrades(json::Value lastId, const std::string_view & pair) {
-	auto r = requestExchange("syncTrades",json::Object({{"lastId",lastId},
-														{"pair",pair}}));
-	TradeHistory  th;
-	for (json::Value v: r["trades"]) th.push_back(Trade::fromJSON(v));
-	return TradesSync {
+static ExtStockApi::TradesSync parseTrades(json::Value r) {
+	ExtStockApi::TradeHistory  th;
+	for (json::Value v: r["trades"]) th.push_back(ExtStockApi::Trade::fromJSON(v));
+	return ExtStockApi::TradesSync {
 		th, r["lastId"]
 	};
 }
 
-ExtStockApi::Orders ExtStockApi::getOpenOrders(const std::string_view & pair) {
-	Orders r;
-
-	auto v = requestExchange("getOpenOrders",pair);
+static ExtStockApi::Orders parseOrders(json::Value v) {
+	ExtStockApi::Orders r;
 	for (json::Value x: v) {
-		Order ord {
+		ExtStockApi::Order ord {
 			x["id"],
 			x["clientOrderId"],
 			x["size"].getNumber(),
@@ -60,9 +58,8 @@ ExtStockApi::Orders ExtStockApi::getOpenOrders(const std::string_view & pair) {
 	return r;
 }
 
-ExtStockApi::Ticker ExtStockApi::getTicker(const std::string_view & pair) {
-	auto resp =  requestExchange("getTicker", pair);
-	return Ticker {
+static ExtStockApi::Ticker parseTicker(json::Value resp) {
+	return ExtStockApi::Ticker {
 		resp["bid"].getNumber(),
 		resp["ask"].getNumber(),
 		resp["last"].getNumber(),
@@ -70,6 +67,45 @@ ExtStockApi::Ticker ExtStockApi::getTicker(const std::string_view & pair) {
 	};
 }
 
+ExtStockApi::TradesSync ExtStockApi::syncTrades(json::Value lastId, const std::string_view & pair) {
+	return parseTrades(requestExchange("syncTrades",json::Object({{"lastId",lastId},
+														{"pair",pair}})));
+}
+
+ExtStockApi::Orders ExtStockApi::getOpenOrders(const std::string_view & pair) {
+	return parseOrders(requestExchange("getOpenOrders",pair));
+}
+
+ExtStockApi::Ticker ExtStockApi::getTicker(const std::string_view & pair) {
+	return parseTicker(requestExchange("getTicker", pair));
+}
+
+ExtStockApi::Snapshot ExtStockApi::getSnapshot(const std::string_view & pair,
+		const std::string_view & asset, const std::string_view & currency,
+		json::Value lastId) {
+	if (connection->snapshot_support) {
+		try {
+			auto resp = requestExchange("getSnapshot", json::Object({
+				{"pair",pair},
+				{"asset",asset},
+				{"currency",currency},
+				{"lastId",lastId}}));
+			Snapshot res;
+			res.orders = parseOrders(resp["orders"]);
+			res.trades = parseTrades(resp["trades"]);
+			res.assetBalance = resp["asset"].getNumber();
+			res.currencyBalance = resp["currency"].getNumber();
+			res.ticker = parseTicker(resp["ticker"]);
+			return res;
+		} catch (const AbstractExtern::Exception &e) {
+			//older broker - fallback to individual requests
+			if (!e.isResponse() || e.getMsg() != "Method not implemented") throw;
+			connection->snapshot_support = false;
+		}
+	}
+	return IStockApi::getSnapshot(pair, asset, currency, lastId);
+}
+
 json::Value  ExtStockApi::placeOrder(const std::string_view & pair,
 		double size, double price,json::Value clientId,
 		json::Value replaceId,double replaceSize) {
@@ -121,6 +157,19 @@ void ExtStockApi::Connection::onConnect() {
 	} catch (...) {
 		//empty
 	}
+	try {
+		//historical data are transfered as packed block of numbers
+		jsonRequestExchange("packed", json::Value());
+	} catch (...) {
+		//empty
+	}
+	try {
+		//broker which can process requests concurrently accepts tagged requests
+		jsonRequestExchange("mux", json::Value());
+		mux_mode = true;
+	} catch (...) {
+		//empty
+	}
 	ondra_shared::LogObject lg("");
 	bool debug= lg.isLogLevelEnabled(ondra_shared::LogLevel::debug);
 	if (debug) {
@@ -131,6 +180,7 @@ void ExtStockApi::Connection::onConnect() {
 		}
 	}
 	broker_info = jsonRequestExchange("getBrokerInfo", json::Value());
+	snapshot_support = true;
 	instance_counter++;
 }
 
@@ -298,6 +348,22 @@ std::uint64_t ExtStockApi::downloadMinuteData(const std::string_view &asset,
 		std::uint64_t time_from, std::uint64_t time_to,
 		HistData &xdata) {
 
+	auto cache = MinuteHistoryCache::getInstance();
+	if (cache != nullptr) {
+		return cache->download(connection->getName(), asset, currency, time_from, time_to, xdata,
+				[&](std::uint64_t from, std::uint64_t to, HistData &data) {
+			return downloadMinuteDataDirect(asset, currency, hint_pair, from, to, data);
+		});
+	} else {
+		return downloadMinuteDataDirect(asset, currency, hint_pair, time_from, time_to, xdata);
+	}
+}
+
+std::uint64_t ExtStockApi::downloadMinuteDataDirect(const std::string_view &asset,
+		const std::string_view &currency, const std::string_view &hint_pair,
+		std::uint64_t time_from, std::uint64_t time_to,
+		HistData &xdata) {
+
 	auto resp = requestExchange("downloadMinuteData", json::Object{
 			{"asset",asset},
 			{"currency",currency},
@@ -307,7 +373,17 @@ std::uint64_t ExtStockApi::downloadMinuteData(const std::string_view &asset,
 		});
     json::Value recv_data = resp["data"];
     json::Value start_time = resp["start"];
-    if (recv_data.empty() || !recv_data[0].isContainer())  {
+    if (recv_data.type() == json::string) {
+        if (resp["ohlc"].getBool()) {
+            OHLCData data;
+            unpackData(recv_data, data);
+            xdata = std::move(data);
+        } else {
+            MinuteData data;
+            unpackData(recv_data, data);
+            xdata = std::move(data);
+        }
+    } else if (recv_data.empty() || !recv_data[0].isContainer())  {
         MinuteData data;
         for (json::Value v: recv_data) {
             data.push_back(v.getNumber());
@@ -40,6 +40,10 @@ public:
 			json::Value replaceId,double replaceSize) override;
 	virtual void reset(const std::chrono::system_clock::time_point &tp) override;
 	virtual MarketInfo getMarketInfo(const std::string_view & pair) override;
+	virtual Snapshot getSnapshot(const std::string_view & pair,
+			const std::string_view & asset,
+			const std::string_view & currency,
+			json::Value lastId) override;
 	virtual std::vector<std::string> getAllPairs() override;
 	virtual BrokerInfo getBrokerInfo()  override;
 	virtual void setApiKey(json::Value keyData) override;
@@ -74,13 +78,15 @@ protected:
 		bool wasRestarted(int &counter);
 		const std::string &getName() const {return this->name;}
 		std::recursive_mutex &getLock() const {return lock;}
-		bool isActive() const {return this->chldid != -1;}
+		bool isActive() const {return isRunning();}
 		virtual ~Connection() {}
 		json::Value getBrokerInfo() const;
 		json::Value getBrokerInfo(std::string_view subaccount) const;
 		void refreshBrokerInfo();
 		std::chrono::system_clock::time_point getLastActivity();
 		json::Value jsonRequestExchange(json::String name, json::Value args);
+		///broker supports getSnapshot (cleared on reconnect)
+		std::atomic<bool> snapshot_support = true;
 	protected:
 		std::atomic<int> instance_counter = 0;
 		json::Value broker_info;
@@ -94,6 +100,14 @@ protected:
 	std::chrono::system_clock::time_point lastActivity, lastReset;
 
 	ExtStockApi(std::shared_ptr<Connection> connection, const std::string &subaccid);
+
+	///Downloads minute data from the broker bypassing the history cache
+	std::uint64_t downloadMinuteDataDirect(const std::string_view &asset,
+					  const std::string_view &currency,
+					  const std::string_view &hint_pair,
+					  std::uint64_t time_from,
+					  std::uint64_t time_to,
+					  HistData &data);
 };
 
 
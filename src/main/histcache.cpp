@@ -0,0 +1,266 @@
+/*
+ * histcache.cpp
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#include "histcache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <variant>
+#include <shared/logOutput.h>
+
+using ondra_shared::logError;
+
+namespace {
+
+struct FileHeader {
+	char magic[8];
+	std::uint64_t begin;
+	std::uint64_t count;
+};
+
+static const char file_magic[8] = {'M','M','H','C','A','C','H','1'};
+
+std::shared_ptr<MinuteHistoryCache> global_instance;
+std::mutex global_lock;
+
+}
+
+MinuteHistoryCache::MinuteHistoryCache(const std::string &path):path(path) {}
+
+MinuteHistoryCache::~MinuteHistoryCache() {
+	flush();
+}
+
+void MinuteHistoryCache::setInstance(std::shared_ptr<MinuteHistoryCache> inst) {
+	std::lock_guard _(global_lock);
+	global_instance = inst;
+}
+
+std::shared_ptr<MinuteHistoryCache> MinuteHistoryCache::getInstance() {
+	std::lock_guard _(global_lock);
+	return global_instance;
+}
+
+std::vector<double> MinuteHistoryCache::toMinuteData(const IHistoryDataSource::HistData &data) {
+	std::vector<double> out;
+	std::visit([&](const auto &x){
+		using T = std::remove_const_t<std::remove_reference_t<decltype(x)> >;
+		out.reserve(x.size());
+		if constexpr(std::is_same_v<T, IHistoryDataSource::MinuteData>) {
+			out.insert(out.end(), x.begin(), x.end());
+		} else {
+			for (const auto &ohlc: x) {
+				double du = ohlc.high-ohlc.open;
+				double dw = ohlc.open-ohlc.low;
+				if (du > 2*dw) {
+					out.push_back(ohlc.high);
+				} else if (dw > 2*du) {
+					out.push_back(ohlc.low);
+				} else {
+					out.push_back(ohlc.close);
+				}
+			}
+		}
+	}, data);
+	return out;
+}
+
+MinuteHistoryCache::PBlock MinuteHistoryCache::getBlock(const std::string_view &source, const std::string_view &asset, const std::string_view &currency) {
+	std::string name;
+	for (const auto &part: {source, asset, currency}) {
+		if (!name.empty()) name.push_back('_');
+		for (char c: part) name.push_back(std::isalnum(c)?c:'-');
+	}
+	std::lock_guard _(lock);
+	auto iter = blocks.find(name);
+	if (iter == blocks.end()) {
+		while (blocks.size() >= max_blocks) {
+			auto lru = blocks.end();
+			for (auto j = blocks.begin(); j != blocks.end(); ++j) {
+				//block in use can't be removed
+				if (j->second.use_count() == 1 && (lru == blocks.end() || j->second->last_use < lru->second->last_use)) lru = j;
+			}
+			if (lru == blocks.end()) break;
+			{
+				std::lock_guard __(lru->second->lock);
+				save(*lru->second);
+			}
+			blocks.erase(lru);
+		}
+		auto b = std::make_shared<Block>();
+		b->fname = path + "/" + name + ".mhc";
+		iter = blocks.emplace(name, b).first;
+	}
+	iter->second->last_use = ++counter;
+	return iter->second;
+}
+
+void MinuteHistoryCache::load(Block &b) {
+	if (b.loaded) return;
+	b.loaded = true;
+	std::ifstream f(b.fname, std::ios::in|std::ios::binary);
+	if (!f) return;
+	FileHeader hdr;
+	if (!f.read(reinterpret_cast<char *>(&hdr), sizeof(hdr))
+			|| std::memcmp(hdr.magic, file_magic, sizeof(file_magic)) != 0
+			|| hdr.count > max_minutes) {
+		logError("History cache: invalid file, ignored - $1", b.fname);
+		return;
+	}
+	std::vector<double> prices(hdr.count);
+	if (!f.read(reinterpret_cast<char *>(prices.data()), prices.size()*sizeof(double))) {
+		logError("History cache: truncated file, ignored - $1", b.fname);
+		return;
+	}
+	b.begin = hdr.begin;
+	b.prices = std::move(prices);
+}
+
+void MinuteHistoryCache::save(Block &b) {
+	if (!b.dirty) return;
+	b.dirty = false;
+	std::string tmp = b.fname + ".tmp";
+	{
+		std::ofstream f(tmp, std::ios::out|std::ios::trunc|std::ios::binary);
+		FileHeader hdr;
+		std::memcpy(hdr.magic, file_magic, sizeof(file_magic));
+		hdr.begin = b.begin;
+		hdr.count = b.prices.size();
+		f.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+		f.write(reinterpret_cast<const char *>(b.prices.data()), b.prices.size()*sizeof(double));
+		if (!f) {
+			logError("History cache: unable to write - $1", tmp);
+			std::remove(tmp.c_str());
+			return;
+		}
+	}
+	if (std::rename(tmp.c_str(), b.fname.c_str())) {
+		logError("History cache: unable to write - $1", b.fname);
+		std::remove(tmp.c_str());
+	}
+}
+
+void MinuteHistoryCache::merge(Block &b, std::uint64_t tm, std::uint64_t end_tm, const std::vector<double> &data) {
+	if (data.empty()) return;
+	auto records = [&](std::uint64_t x, std::uint64_t y) -> std::size_t {
+		return x > y?std::min<std::size_t>(data.size(), (x - y + minute/2)/minute):0;
+	};
+	//block is trimmed at the side opposite to the merged data
+	bool trim_end = false;
+	if (b.prices.empty() || (tm <= b.begin && end_tm >= b.end()) || tm > b.end() + minute/2) {
+		//no continuation, newer data replaces the block
+		b.begin = tm;
+		b.prices = data;
+	} else if (end_tm > b.end()) {
+		//continues the block
+		std::size_t skip = records(b.end(), tm);
+		b.prices.insert(b.prices.end(), data.begin()+skip, data.end());
+	} else if (tm < b.begin && end_tm >= b.begin) {
+		//precedes the block
+		std::size_t take = records(b.begin, tm);
+		b.prices.insert(b.prices.begin(), data.begin(), data.begin()+take);
+		b.begin -= take*minute;
+		trim_end = true;
+	} else {
+		return;
+	}
+	if (b.prices.size() > max_minutes) {
+		std::size_t rm = b.prices.size() - max_minutes;
+		if (trim_end) {
+			b.prices.resize(max_minutes);
+		} else {
+			b.prices.erase(b.prices.begin(), b.prices.begin()+rm);
+			b.begin += rm*minute;
+		}
+	}
+	b.dirty = true;
+}
+
+std::uint64_t MinuteHistoryCache::download(const std::string_view &source, const std::string_view &asset, const std::string_view &currency,
+		std::uint64_t time_from, std::uint64_t time_to, IHistoryDataSource::HistData &data, const DownloadFn &dwn) {
+
+	PBlock b = getBlock(source, asset, currency);
+	std::lock_guard _(b->lock);
+	load(*b);
+
+	std::vector<double> out;
+	std::uint64_t ret = 0;
+	if (b->prices.empty() || time_to > b->end()) {
+		//download missing tail at once, then the rest can be served from the block
+		std::uint64_t from = b->prices.empty()?time_from:std::max(time_from, b->end());
+		std::vector<std::vector<double> > parts;
+		std::uint64_t n = time_to;
+		do {
+			IHistoryDataSource::HistData tmp;
+			ret = dwn(from, n, tmp);
+			if (!ret) break;
+			parts.push_back(toMinuteData(tmp));
+			n = ret;
+		} while (n > from && !parts.back().empty() && !b->prices.empty());
+		for (auto iter = parts.rbegin(); iter != parts.rend(); ++iter) {
+			out.insert(out.end(), iter->begin(), iter->end());
+		}
+		if (!out.empty()) {
+			merge(*b, n, time_to, out);
+			ret = n;
+		}
+	}
+	if (!out.empty() || b->prices.empty() || time_from >= b->end()) {
+		//already served by the download above
+	} else if (time_to > b->begin) {
+		//also when the tail is not available, the rest is served from the block
+		std::uint64_t f = std::max(time_from, b->begin);
+		std::size_t i = (f - b->begin + minute - 1)/minute;
+		std::size_t j = std::min(b->prices.size(), static_cast<std::size_t>((time_to - b->begin + minute - 1)/minute));
+		if (i < j) out.assign(b->prices.begin()+i, b->prices.begin()+j);
+		ret = f == time_from?time_from:b->begin;
+	} else {
+		IHistoryDataSource::HistData tmp;
+		ret = dwn(time_from, time_to, tmp);
+		out = toMinuteData(tmp);
+		if (ret) merge(*b, ret, time_to, out);
+	}
+	//request is complete, so store result
+	if (ret == 0 || ret <= time_from) save(*b);
+	data = std::move(out);
+	return ret;
+}
+
+std::vector<double> MinuteHistoryCache::read(const std::string_view &source, const std::string_view &asset, const std::string_view &currency,
+		std::uint64_t time_from, const FetchFn &fetch) {
+
+	PBlock b = getBlock(source, asset, currency);
+	std::lock_guard _(b->lock);
+	load(*b);
+
+	if (b->prices.empty() || time_from < b->begin || time_from > b->end()) {
+		std::uint64_t f = (time_from/day)*day;
+		std::vector<double> data = fetch(f);
+		b->prices.clear();
+		merge(*b, f, f + data.size()*minute, data);
+	} else {
+		//the history service is requested by whole days, overlapping part is skipped by merge
+		std::uint64_t e = (b->end()/day)*day;
+		std::vector<double> data = fetch(e);
+		merge(*b, e, e + data.size()*minute, data);
+	}
+	save(*b);
+	if (b->prices.empty() || time_from >= b->end()) return {};
+	std::size_t i = time_from > b->begin?(time_from - b->begin + minute - 1)/minute:0;
+	return std::vector<double>(b->prices.begin()+i, b->prices.end());
+}
+
+void MinuteHistoryCache::flush() {
+	std::lock_guard _(lock);
+	for (auto &item: blocks) {
+		std::lock_guard __(item.second->lock);
+		save(*item.second);
+	}
+}
@@ -0,0 +1,114 @@
+/*
+ * histcache.h
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#ifndef SRC_MAIN_HISTCACHE_H_
+#define SRC_MAIN_HISTCACHE_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ibrokercontrol.h"
+
+///Persistent cache of minute price history
+/**
+ * Cache holds one continuous block of minute prices for each source (broker), asset and currency.
+ * The block is extended when data outside of the block are requested, so only the missing
+ * part is downloaded. Blocks are stored in the directory, one file per block, so they
+ * survive restart of the service
+ */
+class MinuteHistoryCache {
+public:
+	///Length of one record in milliseconds
+	static constexpr std::uint64_t minute = 60000;
+	///Length of one day in milliseconds
+	static constexpr std::uint64_t day = 1440*minute;
+	///Maximum count of records in the block, older records are removed
+	static constexpr std::size_t max_minutes = 2*366*1440;
+	///Maximum count of blocks held in the memory
+	static constexpr std::size_t max_blocks = 8;
+
+	///Function which downloads data - follows the contract of IHistoryDataSource::downloadMinuteData
+	using DownloadFn = std::function<std::uint64_t(std::uint64_t time_from, std::uint64_t time_to, IHistoryDataSource::HistData &data)>;
+	///Function which downloads minute prices starting at given time up to now
+	using FetchFn = std::function<std::vector<double>(std::uint64_t time_from)>;
+
+	MinuteHistoryCache(const std::string &path);
+	~MinuteHistoryCache();
+
+	///Download minute data through the cache
+	/**
+	 * Function has the same contract as IHistoryDataSource::downloadMinuteData. Requests covered
+	 * by the cache are served without downloading. Returned data are always MinuteData
+	 *
+	 * @param source name of the source (broker)
+	 * @param asset asset
+	 * @param currency currency
+	 * @param time_from starting time
+	 * @param time_to ending time (excluded)
+	 * @param data receives data
+	 * @param dwn function which downloads missing data
+	 * @return see IHistoryDataSource::downloadMinuteData
+	 */
+	std::uint64_t download(const std::string_view &source, const std::string_view &asset, const std::string_view &currency,
+			std::uint64_t time_from, std::uint64_t time_to, IHistoryDataSource::HistData &data, const DownloadFn &dwn);
+
+	///Read minute prices from given time up to now
+	/**
+	 * @param source name of the source
+	 * @param asset asset
+	 * @param currency currency
+	 * @param time_from starting time
+	 * @param fetch function which downloads missing data
+	 * @return minute prices
+	 */
+	std::vector<double> read(const std::string_view &source, const std::string_view &asset, const std::string_view &currency,
+			std::uint64_t time_from, const FetchFn &fetch);
+
+	///Write all modified blocks to the disk
+	void flush();
+
+	///Sets process wide instance (nullptr disables caching)
+	static void setInstance(std::shared_ptr<MinuteHistoryCache> inst);
+	///Retrieves process wide instance (can be nullptr)
+	static std::shared_ptr<MinuteHistoryCache> getInstance();
+
+	///Converts history data to minute prices
+	static std::vector<double> toMinuteData(const IHistoryDataSource::HistData &data);
+
+protected:
+
+	struct Block {
+		std::mutex lock;
+		std::string fname;
+		bool loaded = false;
+		bool dirty = false;
+		std::uint64_t begin = 0;
+		std::vector<double> prices;
+		std::size_t last_use = 0;
+		std::uint64_t end() const {return begin + prices.size()*minute;}
+	};
+
+	using PBlock = std::shared_ptr<Block>;
+
+	std::string path;
+	std::mutex lock;
+	std::map<std::string, PBlock, std::less<> > blocks;
+	std::size_t counter = 0;
+
+	PBlock getBlock(const std::string_view &source, const std::string_view &asset, const std::string_view &currency);
+	static void load(Block &b);
+	static void save(Block &b);
+	///Merges data [tm, end_tm) to the block
+	static void merge(Block &b, std::uint64_t tm, std::uint64_t end_tm, const std::vector<double> &data);
+};
+
+
+
+#endif /* SRC_MAIN_HISTCACHE_H_ */
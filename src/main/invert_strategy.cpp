@@ -7,6 +7,7 @@
 
 #include "invert_strategy.h"
 #include <stdexcept>
+#include <vector>
 #include <imtjson/object.h>
 InvertStrategy::InvertStrategy(PStrategy target):target(target),inited(false) {
 
@@ -128,6 +129,25 @@ double InvertStrategy::calcCurrencyAllocation(double price, bool leveraged) cons
 	return getCurrencyFromBal(target->calcCurrencyAllocation(1.0/price, leveraged), price);
 }
 
+void InvertStrategy::calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const {
+	//inverted prices are descending, target still handles them in one pass
+	std::vector<double> inv(count);
+	for (std::size_t i = 0; i < count; i++) inv[i] = 1.0/prices[i];
+	target->calcChartBatch(inv.data(), count, out);
+	for (std::size_t i = 0; i < count; i++) {
+		if (out[i].valid) {
+			double b = collateral+last_pos*(prices[i] - last_price);
+			out[i] = {
+				true,
+				getAssetsFromPos(out[i].position, b, prices[i]),
+				getCurrencyFromBal(out[i].budget, prices[i]),
+			};
+		} else {
+			out[i] = {false};
+		}
+	}
+}
+
 IStrategy::ChartPoint InvertStrategy::calcChart(double price) const {
 	auto x = target->calcChart(1.0/price);
 	double b = collateral+last_pos*(price - last_price);
@@ -38,6 +38,7 @@ public:
 	virtual double getEquilibrium(double assets) const;
 	virtual double calcCurrencyAllocation(double price, bool leveraged) const;
 	virtual IStrategy::ChartPoint calcChart(double price) const;
+	virtual void calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const;
 	virtual PStrategy onIdle(const IStockApi::MarketInfo &minfo,
 			const IStockApi::Ticker &curTicker, double assets,
 			double currency) const;
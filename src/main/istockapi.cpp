@@ -285,4 +285,14 @@ double IStockApi::MarketInfo::tickToPrice(std::int64_t tick) const {
 	}
 }
 
-
+IStockApi::Snapshot IStockApi::getSnapshot(const std::string_view &pair,
+		const std::string_view &asset, const std::string_view &currency,
+		json::Value lastId) {
+	Snapshot res;
+	res.orders = getOpenOrders(pair);
+	res.trades = syncTrades(lastId, pair);
+	res.assetBalance = getBalance(asset, pair);
+	res.currencyBalance = getBalance(currency, pair);
+	res.ticker = getTicker(pair);
+	return res;
+}
@@ -212,6 +212,15 @@ public:
 
 	using Orders = std::vector<Order>;
 
+	///Everything the trader needs for one cycle
+	struct Snapshot {
+		Orders orders;
+		TradesSync trades;
+		double assetBalance;
+		double currencyBalance;
+		Ticker ticker;
+	};
+
 	///Retrieves available balance for the symbol
 	/**
 	 * @param symb currency or asset symbol
@@ -287,6 +296,22 @@ public:
 	 * @return market information
 	 */
 	virtual MarketInfo getMarketInfo(const std::string_view & pair) = 0;
+
+	///Retrieve open orders, new trades, balances and ticker at once
+	/**
+	 * @param pair trading pair
+	 * @param asset asset symbol (for balance)
+	 * @param currency currency symbol (for balance)
+	 * @param lastId last seen trade (see syncTrades)
+	 * @return snapshot
+	 *
+	 * Default implementation calls getOpenOrders, syncTrades, getBalance (twice) and
+	 * getTicker. The broker can override this function to collect all data in single request
+	 */
+	virtual Snapshot getSnapshot(const std::string_view & pair,
+			const std::string_view & asset,
+			const std::string_view & currency,
+			json::Value lastId);
 	//Retrieves trading fees
 	/*
 	 *
@@ -16,6 +16,18 @@ public:
 	virtual void store(json::Value data) = 0;
 	virtual json::Value load() = 0;
 	virtual void erase() = 0;
+	///Stores incremental update
+	/**
+	 * The storage which supports incremental updates writes the update to a journal. Function
+	 * load() then returns stored data merged with all updates. Function store() performs
+	 * compaction (writes whole data and clears the journal)
+	 *
+	 * @param set object - its keys replace keys of the stored object
+	 * @param append object - its keys contains arrays appended to the arrays of the stored object
+	 * @retval true update stored
+	 * @retval false incremental updates are not supported, caller must use store()
+	 */
+	virtual bool update(json::Value set, json::Value append) {return false;}
 	virtual ~IStorage() {}
 
 };
@@ -91,6 +91,17 @@ public:
 	virtual double calcCurrencyAllocation(double price, bool leveraged) const = 0;
 	virtual ~IStrategy() {}
 	virtual ChartPoint calcChart(double price) const = 0;
+	///Calculates chart for many prices at once
+	/**
+	 * @param prices array of prices, preferably ascending (price grid)
+	 * @param count count of prices
+	 * @param out array of count items, receives results
+	 *
+	 * Default implementation calls calcChart() for each price
+	 */
+	virtual void calcChartBatch(const double *prices, std::size_t count, ChartPoint *out) const {
+		for (std::size_t i = 0; i < count; i++) out[i] = calcChart(prices[i]);
+	}
 	virtual double getCenterPrice(double lastPrice, double assets) const = 0;
 
 
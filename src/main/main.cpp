@@ -30,6 +30,9 @@
 #include "webcfg.h"
 #include "spawn.h"
 #include <random>
+#include <atomic>
+#include <deque>
+#include <map>
 
 #include "../imtjson/src/imtjson/binary.h"
 #include "../server/src/simpleServer/http_hostmapping.h"
@@ -44,6 +47,8 @@
 #include "../shared/logOutput.h"
 
 #include "rptapi.h"
+#include "histcache.h"
+#include <shared/filesystem.h>
 
 using ondra_shared::StdLogFile;
 using ondra_shared::StrViewA;
@@ -126,117 +131,176 @@ public:
 
 };
 
-void trader_cycle(PReport rpt, PPerfModule perfmod, Scheduler sch, int pos, std::chrono::steady_clock::time_point nextRun) {
+///count of broker groups being performed by the trader worker pool
+static ondra_shared::Countdown trader_pending(0);
+///set during shutdown - no more rounds are scheduled
+static std::atomic<bool> trader_stop(false);
 
-	if (pos == 0) {
-		nextRun = nextRun+std::chrono::minutes(1);
-		traders.lock()->resetBrokers();
+static void trader_perform(const std::string &ident, const shared_lockable_ptr<NamedMTrader> &selected) {
+	try {
+		auto t1 = std::chrono::system_clock::now();
+		auto tl = selected.lock();
+		if (tl->retired) return;
+		tl->perform(false);
+		tl.release();
+		auto t2 = std::chrono::system_clock::now();
+		traders.lock()->report_util(ident, std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count());
+	} catch (std::exception &e) {
+		logError("Scheduler exception: $1", e.what());
+	}
+}
+
+///Performs one round of all traders
+/**
+ * Traders are grouped by the broker. Each group is performed serially (broker is
+ * single process, requests are serialized anyway), but the groups run in parallel
+ * on the worker pool. The report is generated once the last group finishes
+ */
+void trader_cycle(PReport rpt, PPerfModule perfmod, Scheduler sch, Worker wrk, std::chrono::steady_clock::time_point nextRun) {
+
+	using TraderList = std::vector<std::pair<std::string, shared_lockable_ptr<NamedMTrader> > >;
+
+	if (trader_stop) return;
+
+	nextRun = nextRun+std::chrono::minutes(1);
+	auto round_start = std::chrono::system_clock::now();
+
+	std::map<std::string, TraderList> groups;
+	std::size_t count = 0;
+	{
+		auto tl = traders.lock();
+		tl->resetBrokers();
+		tl->enumTraders([&](const auto & trinfo){
+			const auto &t = trinfo.second;
+			groups[t.lock_shared()->broker_group].push_back({std::string(trinfo.first), t});
+			count++;
+		});
 	}
 
-	shared_lockable_ptr<NamedMTrader> selected;
-	int p = pos;
-	traders.lock_shared()->enumTraders([&](const auto & trinfo){
-		if (p == 0) selected = trinfo.second;
-		p--;
-	});
-	if (selected == nullptr) {
+	auto finish = [=]() mutable {
+		auto round_end = std::chrono::system_clock::now();
+		traders.lock()->report_round(std::chrono::duration_cast<std::chrono::milliseconds>(round_end-round_start).count(), count);
 		auto rptl = rpt.lock();
 		rptl->perfReport(perfmod.lock()->getReport());
 		rptl->genReport();
+		if (trader_stop) return;
 		sch.at(nextRun) >> [=]{
-			trader_cycle(rpt,perfmod,  sch, 0, nextRun);
+			trader_cycle(rpt,perfmod, sch, wrk, nextRun);
 		};
-	} else {
-		try {
+	};
+
+	if (groups.empty()) {
+		finish();
+		return;
+	}
+
+	auto remain = std::make_shared<std::atomic<std::size_t> >(groups.size());
+	for (auto &&g: groups) {
+		trader_pending++;
+		wrk >> [=, broker = g.first, lst = std::move(g.second)]() mutable {
 			auto t1 = std::chrono::system_clock::now();
-			auto tl = selected.lock();
-			std::string_view ident = tl->ident;
-			tl->perform(false);
-			tl.release();
+			for (const auto &x: lst) {
+				if (trader_stop) break;
+				trader_perform(x.first, x.second);
+			}
 			auto t2 = std::chrono::system_clock::now();
-			traders.lock()->report_util(ident, std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count());
-		} catch (std::exception &e) {
-			logError("Scheduler exception: $1", e.what());
-		}
-		sch.after(std::chrono::milliseconds(1)) >> [=]{
-			trader_cycle(rpt,perfmod,  sch, pos+1, nextRun);
+			traders.lock()->report_broker_util(broker, std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count());
+			if (--(*remain) == 0) {
+				sch.immediate() >> std::move(finish);
+			}
+			--trader_pending;
 		};
 	}
 }
 
 class StreamState: public RefCntObj {
 public:
-	StreamState(simpleServer::HTTPRequest req, simpleServer::Stream s);
+	StreamState(simpleServer::HTTPRequest req, simpleServer::Stream s, std::size_t max_backlog);
 
-	bool sendAsync(json::Value v);
+	bool sendAsync(const Report::StreamFrame &frame);
 protected:
 	simpleServer::HTTPRequest req;
 	simpleServer::Stream s;
 	bool ok;
 	bool ip;
+	///frames waiting to be sent
+	std::deque<Report::StreamFrame> backlog;
+	///frame being sent, when it was the only one waiting (sent without copying)
+	Report::StreamFrame curFrame;
+	///frames being sent, gathered to one buffer
 	std::string curBuff;
-	std::string nextBuff;
+	///count of bytes waiting and being sent
+	std::size_t backlog_size = 0;
+	///maximum bytes in backlog, slower client is disconnected
+	std::size_t max_backlog;
 	std::recursive_mutex lock;
-	ondra_shared::linear_map<std::size_t, std::size_t> hcache;
 
 	void sendBuffer();
 	void sendBuffer(ondra_shared::BinaryView b);
+	void dropBacklog();
 };
 
-StreamState::StreamState(simpleServer::HTTPRequest req, simpleServer::Stream s):req(req),s(s),ok(true),ip(false) {}
+StreamState::StreamState(simpleServer::HTTPRequest req, simpleServer::Stream s, std::size_t max_backlog)
+	:req(req),s(s),ok(true),ip(false),max_backlog(max_backlog) {}
 
-bool StreamState::sendAsync(json::Value v) {
+bool StreamState::sendAsync(const Report::StreamFrame &frame) {
 	std::lock_guard _(lock);
 	if (!ok) return false;
-	if (v == nullptr) {
-		hcache.clear();
-		return true;
-	}
-	json::Value ty = v.filter([](const json::Value &x){return x.getKey() != "data";});
-	if (!ty.empty()) {
-		std::hash<json::Value> h;
-		std::size_t hk = h(ty);
-		std::size_t hv = h(v);
-		std::size_t &z = hcache[hk];
-		if (z == hv) return true;
-		z = hv;
+	if (backlog_size + frame->size() > max_backlog && backlog_size) {
+		logWarning("Event stream client is too slow, disconnected (backlog: $1 bytes)", backlog_size);
+		ok = false;
+		dropBacklog();
+		return false;
 	}
-	std::string *t;
-	if (ip) t = &nextBuff; else t = &curBuff;
-	t->append("data: ");
-	v.serialize([&](char c){t->push_back(c);});
-	t->append("\r\n\r\n");
+	backlog.push_back(frame);
+	backlog_size += frame->size();
 	if (!ip) {
 		sendBuffer();
 	}
 	return true;
 }
+void StreamState::dropBacklog() {
+	//data in progress are kept until the write completes
+	for (const auto &f: backlog) backlog_size -= f->size();
+	backlog.clear();
+}
 void StreamState::sendBuffer() {
 	ip = true;
-	sendBuffer(ondra_shared::BinaryView(ondra_shared::StrViewA(curBuff)));
+	if (backlog.size() == 1) {
+		curFrame = std::move(backlog.front());
+		backlog.pop_front();
+		sendBuffer(ondra_shared::BinaryView(ondra_shared::StrViewA(*curFrame)));
+	} else {
+		//all waiting frames are sent by single write
+		curBuff.clear();
+		for (const auto &f: backlog) curBuff.append(*f);
+		backlog.clear();
+		sendBuffer(ondra_shared::BinaryView(ondra_shared::StrViewA(curBuff)));
+	}
 }
 void StreamState::sendBuffer(ondra_shared::BinaryView b) {
 	s->getDirectWrite().writeAsync(b,
 			[me=RefCntPtr<StreamState>(this)](simpleServer::AsyncState st, ondra_shared::BinaryView b) {
+		std::lock_guard _(me->lock);
 		if (st != simpleServer::asyncOK) {
-			std::lock_guard _(me->lock);
 			me->ip = false;
 			me->ok = false;
+			me->dropBacklog();
+		} else if (!b.empty()) {
+			me->sendBuffer(b);
 		} else {
-			std::lock_guard _(me->lock);
-			if (!b.empty()) {
-				me->sendBuffer(b);
+			me->ip = false;
+			if (me->curFrame != nullptr) {
+				me->backlog_size -= me->curFrame->size();
+				me->curFrame.reset();
 			} else {
-				me->ip = false;
+				me->backlog_size -= me->curBuff.size();
 				me->curBuff.clear();
-				if (st == simpleServer::asyncOK) {
-					if (!me->nextBuff.empty()) {
-						std::swap(me->curBuff,me->nextBuff);
-						me->sendBuffer();
-					}
-				} else {
-					me->ok = false;
-				}
+			}
+			if (!me->ok) {
+				me->dropBacklog();
+			} else if (!me->backlog.empty()) {
+				me->sendBuffer();
 			}
 		}
 	});
@@ -298,6 +362,7 @@ int main(int argc, char **argv) {
 						auto storageBinary = servicesection["storage_binary"].getBool(true);
 						auto storageBroker = servicesection["storage_broker"];
 						auto storageVersions = servicesection["storage_versions"].getUInt(5);
+						auto storageJournal = servicesection["storage_journal"].getBool(false);
 						auto listen = servicesection["listen"].getString();
 						auto socket = servicesection["socket"].getPath();
 						auto upload_limit = servicesection["upload_limit"].getUInt(10*1024*1024);
@@ -306,15 +371,19 @@ int main(int argc, char **argv) {
 						auto rptsect = app.config["report"];
 						auto rptpath = rptsect.mandatory["path"].getPath();
 						auto rptinterval = rptsect["interval"].getUInt(864000000);
+						std::size_t rptbacklog = rptsect["stream_backlog"].getUInt(16)*1024*1024;
 						auto dr = rptsect["report_broker"];
 						auto isim = rptsect["include_simulators"].getBool(false);
 						auto threads = servicesection["http_threads"].getUInt(2);
+						auto trader_threads = servicesection["trader_threads"].getUInt(4);
 						auto asyncProvider = simpleServer::ThreadPoolAsync::create(threads,1);
 						auto login_section = app.config["login"];
 						auto backtest_section = app.config["backtest"];
 						auto history_broker = backtest_section.mandatory["history_source"];
 						auto backtest_cache_size = backtest_section["backtest_cache_size"].getUInt(8);
 						auto backtest_in_memory = backtest_section["in_memory"].getBool(false);
+						auto history_cache = backtest_section["history_cache"].getBool(true);
+						auto tick_import_path = backtest_section["tick_import_path"].getPath();
 						auto news_url=app.config["news"]["url"].getString();
 
 
@@ -323,7 +392,7 @@ int main(int argc, char **argv) {
 						PStorageFactory sf;
 
 						if (!storageBroker.defined()) {
-							sf = PStorageFactory(new StorageFactory(storagePath,storageVersions,storageBinary?Storage::binjson:Storage::json));
+							sf = PStorageFactory(new StorageFactory(storagePath,storageVersions,storageBinary?Storage::binjson:Storage::json, storageJournal));
 						} else {
 							sf = PStorageFactory(new ExtStorage(storageBroker.getCurPath(), "storage_broker", storageBroker.getString(), brk_timeout));
 							auto bl = servicesection["backup_locally"].getBool(false);
@@ -333,6 +402,13 @@ int main(int argc, char **argv) {
 							}
 						}
 
+						if (history_cache) {
+							std::string hpath = storagePath+"/_history";
+							std::error_code ec;
+							std::filesystem::create_directories(hpath, ec);
+							MinuteHistoryCache::setInstance(std::make_shared<MinuteHistoryCache>(hpath));
+						}
+
 						PStorage rptstore = std::make_unique<MemStorage>();
 						IStorage *rptjson=rptstore.get();
 						PReport rpt = PReport::make(std::move(rptstore), ReportConfig{rptinterval});
@@ -353,6 +429,7 @@ int main(int argc, char **argv) {
 
 
 						Worker wrk = schedulerGetWorker(sch);
+						Worker trader_wrk = Worker::create(std::max<unsigned int>(trader_threads,1));
 
 
 						traders = traders.make(
@@ -410,7 +487,7 @@ int main(int argc, char **argv) {
 								"/api/admin",ondra_shared::shared_function<bool(simpleServer::HTTPRequest, ondra_shared::StrViewA)>(WebCfg(webcfgstate,
 										name,
 										traders,
-										[=](WebCfg::Action &&a) mutable {sch.immediate() >> std::move(a);},jwt, phb, upload_limit, share_limit))
+										[=](WebCfg::Action &&a) mutable {sch.immediate() >> std::move(a);},jwt, phb, upload_limit, share_limit, tick_import_path))
 							});
 							paths.push_back({
 								"/set_cookie",[](simpleServer::HTTPRequest req, const ondra_shared::StrViewA &) mutable {
@@ -446,8 +523,8 @@ int main(int argc, char **argv) {
 											("Connection","close")
 											("X-Accel-Buffering","no"));
 									s.flush();
-									rpt.lock()->addStream([state = RefCntPtr<StreamState>(new StreamState(req, s))](const json::Value &v)mutable{
-										return state->sendAsync(v);
+									rpt.lock()->addStream([state = RefCntPtr<StreamState>(new StreamState(req, s, rptbacklog))](const Report::StreamFrame &f)mutable{
+										return state->sendAsync(f);
 									});
 
 									return true;
@@ -465,12 +542,13 @@ int main(int argc, char **argv) {
                                         }
                                         auto trader = qp["trader"];
                                         auto interval = qp["interval"].getUInt();
+                                        auto after = qp["after"].getUInt();
                                         if (interval == 0) {
                                             req.sendErrorPage(404);
                                         } else {
-                                            auto t = traders.lock_shared()->find(trader);
-                                            if (t != nullptr) {
-                                                json::Value ohlc = t.lock_shared()->getOHLC(interval);
+                                            auto snapshot = traders.lock_shared()->getSnapshot(trader);
+                                            if (snapshot != nullptr) {
+                                                json::Value ohlc = snapshot->getOHLC(interval, after);
                                                 auto s = req.sendResponse("application/json");
                                                 ohlc.serialize(s);
                                                 s.flush();
@@ -491,8 +569,8 @@ int main(int argc, char **argv) {
                                             ("Connection","close")
                                             ("X-Accel-Buffering","no"));
                                     s.flush();
-                                    rpt.lock()->addStream([state = RefCntPtr<StreamState>(new StreamState(req, s))](const json::Value &v)mutable{
-                                        return state->sendAsync(v);
+                                    rpt.lock()->addStream([state = RefCntPtr<StreamState>(new StreamState(req, s, rptbacklog))](const Report::StreamFrame &f)mutable{
+                                        return state->sendAsync(f);
                                     });
 
                                     return true;
@@ -700,7 +778,7 @@ int main(int argc, char **argv) {
 							};
 
 
-							trader_cycle(rpt, perfmod, sch, 0, std::chrono::steady_clock::now());
+							trader_cycle(rpt, perfmod, sch, trader_wrk, std::chrono::steady_clock::now());
 							sch.each(std::chrono::seconds(30)) >> [=]()mutable{
 								rpt.lock()->pingStreams();
 							};
@@ -723,10 +801,13 @@ int main(int argc, char **argv) {
 
 						cntr.dispatch();
 
+						trader_stop = true;
 						sch.removeAll();
 						logNote("---- Waiting to finish cycle ----");
+						trader_pending.wait();
 						sch.sync();
 						traders.lock()->clear();
+						MinuteHistoryCache::setInstance(nullptr);
 					}
 					logNote("---- Exit ----");
 
@@ -5,6 +5,7 @@
 #include "mtrader.h"
 #include "strategy.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <shared/logOutput.h>
@@ -123,7 +124,7 @@ MTrader::MTrader(IStockSelector &stock_selector,
 		//create independed wallet db
 		wcfg.walletDB = wcfg.walletDB.make();
 	}
-
+	publishSnapshot();
 }
 
 
@@ -169,6 +170,7 @@ void MTrader::init() {
 		initialize();
 		loadState();
 		need_load = false;
+		publishSnapshot();
 	}
 }
 
@@ -199,9 +201,9 @@ void MTrader::alertTrigger(const Status &st, double price, int dir, AlertReason
 		tr.eff_size-=norm.normAccum;
 		accumulated +=norm.normAccum;
 		position -=norm.normAccum;
-		trades.push_back(TWBItem(tr, last_np+=norm.normProfit, last_ap+=norm.normAccum, norm.neutralPrice, false,false, static_cast<char>(dir), static_cast<char>(reason)));
+		addTrade(TWBItem(tr, last_np+=norm.normProfit, last_ap+=norm.normAccum, norm.neutralPrice, false,false, static_cast<char>(dir), static_cast<char>(reason)));
 	} else {
-		trades.push_back(TWBItem(tr, last_np, last_ap, 0, false, true, static_cast<char>(dir), static_cast<char>(reason)));
+		addTrade(TWBItem(tr, last_np, last_ap, 0, false, true, static_cast<char>(dir), static_cast<char>(reason)));
 	}
 	refresh_minfo = true;
 }
@@ -234,10 +236,12 @@ void MTrader::perform(bool manually) {
 			}
 		}
 
+		//Get opened orders, trades, balances and ticker in single request (if supported)
+		auto snapshot = stock->getSnapshot(cfg.pairsymb, minfo.asset_symbol, minfo.currency_symbol, lastTradeId);
 		//Get opened orders
-		auto orders = getOrders();
+		auto orders = getOrders(snapshot.orders);
 		//get current status
-		auto status = getMarketStatus();
+		auto status = getMarketStatus(snapshot);
 
 		if (status.brokerCurrencyBalance.has_value()) {
 			wcfg.balanceCache.lock()->put(cfg.broker, minfo.wallet_id, minfo.currency_symbol, *status.brokerCurrencyBalance);
@@ -498,14 +502,9 @@ void MTrader::perform(bool manually) {
 
 		if (!manually) {
 			if (chart.empty() || chart.back().time < status.chartItem.time) {
-				//store current price (to build chart)
-				chart.push_back(status.chartItem);
-				{
-				    unsigned int max_count = std::max<unsigned int>(cfg.spread->get_required_history_length(), 240*60);
-					//delete very old data from chart
-					if (chart.size() > max_count)
-						chart.erase(chart.begin(),chart.end()-max_count);
-				}
+				//store current price (to build chart), very old data are dropped
+				chart.set_capacity(chartCapacity());
+				appendChart(status.chartItem);
 				cfg.spread->point(spread_state, status.curPrice, false);
 			}
 		}
@@ -532,8 +531,11 @@ void MTrader::perform(bool manually) {
 
 
 MTrader::OrderPair MTrader::getOrders() {
+	return getOrders(stock->getOpenOrders(cfg.pairsymb));
+}
+
+MTrader::OrderPair MTrader::getOrders(const IStockApi::Orders &data) {
 	OrderPair ret;
-	auto data = stock->getOpenOrders(cfg.pairsymb);
 	for (auto &&x: data) {
 		try {
 			if (x.client_id == magic) {
@@ -637,13 +639,22 @@ static std::pair<double,double> sumTrades(const std::pair<double,double> &a, con
 
 
 MTrader::Status MTrader::getMarketStatus() const {
+	IStockApi::Snapshot snapshot;
+	snapshot.trades = stock->syncTrades(lastTradeId, cfg.pairsymb);
+	snapshot.assetBalance = stock->getBalance(minfo.asset_symbol, cfg.pairsymb);
+	snapshot.currencyBalance = stock->getBalance(minfo.currency_symbol, cfg.pairsymb);
+	snapshot.ticker = stock->getTicker(cfg.pairsymb);
+	return getMarketStatus(snapshot);
+}
+
+MTrader::Status MTrader::getMarketStatus(const IStockApi::Snapshot &snapshot) const {
 
 	Status res;
 
 	IStockApi::Trade ftrade = {json::Value(), 0, 0, 0, 0, 0}, *last_trade = &ftrade;
 
 // merge trades here
-	auto new_trades = stock->syncTrades(lastTradeId, cfg.pairsymb);
+	const auto &new_trades = snapshot.trades;
 	res.new_trades.lastId = new_trades.lastId;
 	for (auto &&k : new_trades.trades) {
 		if (last_trade->price == k.price) {
@@ -657,8 +668,8 @@ MTrader::Status MTrader::getMarketStatus() const {
 		}
 	}
 
-	res.brokerAssetBalance= stock->getBalance(minfo.asset_symbol, cfg.pairsymb);
-	res.brokerCurrencyBalance = stock->getBalance(minfo.currency_symbol, cfg.pairsymb);
+	res.brokerAssetBalance= snapshot.assetBalance;
+	res.brokerCurrencyBalance = snapshot.currencyBalance;
 	res.currencyUnadjustedBalance = *res.brokerCurrencyBalance + wcfg.externalBalance.lock_shared()->get(cfg.broker, minfo.wallet_id, minfo.currency_symbol);
 	auto wdb = wcfg.walletDB.lock_shared();
 	if (minfo.leverage == 0) {
@@ -674,7 +685,7 @@ MTrader::Status MTrader::getMarketStatus() const {
 	res.currencyAvailBalance = wdb->adjBalance(WalletDB::KeyQuery(cfg.broker,minfo.wallet_id,minfo.currency_symbol,uid),*res.brokerCurrencyBalance);
 
 
-	auto ticker = stock->getTicker(cfg.pairsymb);
+	const auto &ticker = snapshot.ticker;
 	res.ticker = ticker;
 	res.curPrice = std::sqrt(ticker.ask*ticker.bid);
 
@@ -862,6 +873,8 @@ void MTrader::loadState() {
 		auto chartSect = st["chart"];
 		if (chartSect.defined()) {
 			chart.clear();
+			ohlc.clear();
+			chart.set_capacity(chartCapacity());
 			for (json::Value v: chartSect) {
 				double ask = v["ask"].getNumber();
 				double bid = v["bid"].getNumber();
@@ -873,21 +886,28 @@ void MTrader::loadState() {
 				}
 				std::uint64_t tm = v["time"].getUIntLong();
 
-				chart.push_back({tm,ask,bid,last});
+				appendChart({tm,ask,bid,last});
 			}
 		}
 		{
 			auto trSect = st["trades"];
 			if (trSect.defined()) {
 				trades.clear();
+				trade_index.clear();
+				trades_changed = true;
 				for (json::Value v: trSect) {
 					TWBItem itm = TWBItem::fromJSON(v);
-					trades.push_back(itm);
+					addTrade(itm);
 				}
 			}
 		}
 		strategy.importState(st["strategy"], minfo);
 
+		//loaded state is the stored state, further changes can be journaled
+		journal_trades = trades.size();
+		journal_chart_time = chart.empty()?0:chart.back().time;
+		journal_records = 0;
+		journal_full = false;
 
 	}
 	tempPr.broker = cfg.broker;
@@ -914,6 +934,16 @@ void MTrader::loadState() {
 
 }
 
+json::Value MTrader::chartItemToJSON(const ChartItem &itm) const {
+	return json::Object({{"time", itm.time},
+		{"ask",minfo.invert_price?1.0/itm.ask:itm.ask},
+		{"bid",minfo.invert_price?1.0/itm.bid:itm.bid},
+		{"last",minfo.invert_price?1.0/itm.last:itm.last}});
+}
+
+///Maximum count of incremental updates before the state is written whole (compaction)
+static const unsigned int journal_compact_limit = 1440;
+
 void MTrader::saveState() {
 	if (storage == nullptr || need_load) return;
 	json::Object obj;
@@ -939,13 +969,30 @@ void MTrader::saveState() {
 		    st.set("partial", {partial_eff_pos.getPos(),partial_eff_pos.getOpen(), partial_position});
 		}
 	}
+	obj.set("strategy",strategy.exportState());
+	std::uint64_t chart_time = chart.empty()?0:chart.back().time;
+
+	//try to append new chart items and trades to the journal
+	if (!journal_full && journal_records < journal_compact_limit && journal_trades <= trades.size()) {
+		json::Array ch;
+		auto chbeg = std::upper_bound(chart.begin(), chart.end(), journal_chart_time, [](std::uint64_t t, const ChartItem &itm){
+			return t < itm.time;
+		});
+		for (auto iter = chbeg; iter != chart.end(); ++iter) ch.push_back(chartItemToJSON(*iter));
+		json::Array tr;
+		for (auto iter = trades.begin()+journal_trades; iter != trades.end(); ++iter) tr.push_back(iter->toJSON());
+		if (storage->update(obj, json::Object({{"chart", ch},{"trades", tr}}))) {
+			journal_trades = trades.size();
+			journal_chart_time = chart_time;
+			++journal_records;
+			return;
+		}
+	}
+
 	{
 		auto ch = obj.array("chart");
 		for (auto &&itm: chart) {
-			ch.push_back(json::Object({{"time", itm.time},
-				{"ask",minfo.invert_price?1.0/itm.ask:itm.ask},
-				{"bid",minfo.invert_price?1.0/itm.bid:itm.bid},
-				{"last",minfo.invert_price?1.0/itm.last:itm.last}}));
+			ch.push_back(chartItemToJSON(itm));
 		}
 	}
 	{
@@ -954,24 +1001,52 @@ void MTrader::saveState() {
 			tr.push_back(itm.toJSON());
 		}
 	}
-	obj.set("strategy",strategy.exportState());
 	storage->store(obj);
+	journal_trades = trades.size();
+	journal_chart_time = chart_time;
+	journal_records = 0;
+	journal_full = false;
+}
+
+
+void MTrader::addTrade(const TWBItem &itm) {
+	trades.push_back(itm);
+	trade_index.emplace(itm.id.toString().str(), trades.size()-1);
+	trades_changed = true;
 }
 
+void MTrader::rebuildTradeIndex() {
+	trade_index.clear();
+	trade_index.reserve(trades.size());
+	for (std::size_t i = 0, cnt = trades.size(); i < cnt; i++) {
+		trade_index.emplace(trades[i].id.toString().str(), i);
+	}
+}
+
+MTrader::TradeHistory::iterator MTrader::findTrade(std::string_view id) {
+	auto rng = trade_index.equal_range(std::string(id));
+	if (rng.first == rng.second) return trades.end();
+	//first trade with the id
+	std::size_t pos = std::min_element(rng.first, rng.second, [](const auto &a, const auto &b){
+		return a.second < b.second;
+	})->second;
+	return trades.begin()+pos;
+}
 
 bool MTrader::eraseTrade(std::string_view id, bool trunc) {
 	init();
-	auto iter = std::find_if(trades.begin(), trades.end(), [&](const IStockApi::Trade &tr) {
-		json::String s = tr.id.toString();
-		return s.str() == id;
-	});
+	auto iter = findTrade(id);
 	if (iter == trades.end()) return false;
 	if (trunc) {
 		trades.erase(iter, trades.end());
 	} else {
 		trades.erase(iter);
 	}
+	rebuildTradeIndex();
+	journal_full = true;
+	trades_changed = true;
 	saveState();
+	publishSnapshot();
 	return true;
 }
 
@@ -984,9 +1059,11 @@ bool MTrader::processTrades(Status &st) {
 	//while the new trade is already in current trades
 	auto iter = std::remove_if(st.new_trades.trades.begin(), st.new_trades.trades.end(),
 			[&](const IStockApi::Trade &t) {
-				return std::find_if(trades.begin(), trades.end(),[&](const IStockApi::Trade &q) {
-					return t.id == q.id;
-				}) != trades.end();
+				//different ids can have the same string form, so all trades of the key are compared
+				auto rng = trade_index.equal_range(std::string(t.id.toString().str()));
+				return std::any_of(rng.first, rng.second, [&](const auto &f) {
+					return trades[f.second].id == t.id;
+				});
 	});
 
 	st.new_trades.trades.erase(iter, st.new_trades.trades.end());
@@ -1046,7 +1123,7 @@ bool MTrader::processTrades(Status &st) {
 		}
         logDebug("(PARTIAL) Trade partial: price=$1, size=$2, final_price=$3, final_size=$4", t.eff_price, t.eff_size,  partial_eff_pos.getOpen(),partial_eff_pos.getPos());
 		bool manual = achieve_mode || !cfg.enabled;
-		trades.push_back(TWBItem(t, last_np+norm_adv, last_ap, last_neutral, !manual, manual));
+		addTrade(TWBItem(t, last_np+norm_adv, last_ap, last_neutral, !manual, manual));
 
 		if (partial_position > target_buy_size
 		        || partial_position < target_sell_size) {
@@ -1078,6 +1155,8 @@ void MTrader::flush_partial(const Status &status) {
             t.norm_accum+=tstate.normAccum;
             t.neutral_price = tstate.neutralPrice;
             t.partial_exec = false;
+            journal_full = true;
+            trades_changed = true;
         }
 
         cfg.spread->point(spread_state, trades.back().price, true);
@@ -1094,6 +1173,9 @@ void MTrader::flush_partial(const Status &status) {
 void MTrader::clearStats() {
 	init();
 	trades.clear();
+	trade_index.clear();
+	journal_full = true;
+	trades_changed = true;
 	position = 0;
 	position_valid = false;
 	adj_wait = 0;
@@ -1102,6 +1184,7 @@ void MTrader::clearStats() {
 	spread_state = cfg.spread->start();
 	saveState();
 	updateEnterPrice();
+	publishSnapshot();
 }
 
 void MTrader::stop() {
@@ -1131,6 +1214,7 @@ void MTrader::reset(const ResetOptions &ropt) {
 			lastPrice = x.price;
 		}
 	}
+	trades_changed = true;
 	auto status = getMarketStatus();
 	double assets;
 	if (position_valid && !trades.empty()) {
@@ -1166,20 +1250,33 @@ void MTrader::reset(const ResetOptions &ropt) {
 	} catch (...) {
 		need_initial_reset = true;
 		saveState();
+		publishSnapshot();
 		throw;
 	}
 
 	saveState();
+	publishSnapshot();
 }
 
 MTrader::Chart MTrader::getChart() const {
-	return chart;
+	return Chart(chart.begin(), chart.end());
+}
+
+std::size_t MTrader::chartCapacity() const {
+	return std::max<std::size_t>(cfg.spread->get_required_history_length(), 240*60);
+}
+
+void MTrader::appendChart(const ChartItem &itm) {
+	chart.push_back(itm);
+	ohlc.add(itm.time, itm.last);
+	ohlc.trim(chart.front().time);
 }
 
 
 void MTrader::addAcceptLossAlert() {
 	Status st = getMarketStatus();
 	alertTrigger(st, st.ticker.last, 0, AlertReason::initial_reset);
+	publishSnapshot();
 }
 
 
@@ -1247,6 +1344,7 @@ void MTrader::setInternalBalancies(double assets, double cur) {
 	position_valid =true;
 	currency= cur;
 	currency_valid = true;
+	publishSnapshot();
 }
 
 
@@ -1374,7 +1472,7 @@ void MTrader::doWithdraw(const Status &st) {
 	accum+=withdraw_size;
 	logInfo("Withdraw from trader: amount=$1, remain=$2, accumulated=$3, accumulated_total=$4", withdraw_size, diff-withdraw_size,accum,x.thisTrader+x.otherTraders+withdraw_size);
 	auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	trades.push_back(IStatSvc::TradeRecord(IStockApi::Trade{
+	addTrade(IStatSvc::TradeRecord(IStockApi::Trade{
 		"WITHDRAW:"+std::to_string(time),
 		static_cast<std::uint64_t>(time),
 		0, lastTradePrice, 0, lastTradePrice
@@ -1438,7 +1536,10 @@ void MTrader::recalcNorm() {
 		cur = newcur;
 		pos = newpos-=res.normAccum;
 	}
+	journal_full = true;
+	trades_changed = true;
 	saveState();
+	publishSnapshot();
 }
 
 void MTrader::fixNorm() {
@@ -1480,7 +1581,10 @@ void MTrader::fixNorm() {
 		trades[i].norm_accum = cura;
 		trades[i].norm_profit = curp;
 	}
+	journal_full = true;
+	trades_changed = true;
 	saveState();
+	publishSnapshot();
 }
 
 double MTrader::getEnterPrice() const {
@@ -1517,8 +1621,52 @@ void MTrader::updateEnterPrice() {
 	acb_state = acb;
 }
 
-json::Value MTrader::getOHLC(std::uint64_t interval) const {
+void MTrader::publishSnapshot() {
+	auto s = std::make_shared<Snapshot>();
+	//chart and bars share chunks with the trader, only changed chunks are copied later
+	s->chart = chart;
+	s->ohlc = ohlc;
+	PSnapshot prev = snapshot_slot->get();
+	if (trades_changed || prev == nullptr) {
+		s->trades = std::make_shared<const TradeHistory>(trades);
+		trades_changed = false;
+	} else {
+		s->trades = prev->trades;
+	}
+	s->minfo = minfo;
+	s->strategy = strategy;
+	s->broker = stock;
+	s->broker_name = cfg.broker;
+	s->pairsymb = cfg.pairsymb;
+	s->currency = currency;
+	s->loaded = !need_load;
+	s->position = position;
+	s->strategy_position = getStrategyPosition();
+	s->partial_position = partial_position;
+	s->accumulated = accumulated;
+	s->enter_price = getEnterPrice();
+	s->enter_price_pos = getEnterPricePos();
+	s->costs = getCosts();
+	s->rpnl = getRPnL();
+	snapshot_slot->set(std::move(s));
+}
+
+json::Value MTrader::Snapshot::getOHLC(std::uint64_t interval, std::uint64_t after) const {
     json::Array out;
+    if (const OHLCRollup::Bars *bars = ohlc.get(interval)) {
+        //precomputed bars
+        auto iter = std::lower_bound(bars->begin(), bars->end(), after, [](const OHLCRollup::Bar &b, std::uint64_t t){
+            return b.time < t;
+        });
+        for (; iter != bars->end(); ++iter) {
+            if (minfo.invert_price) {
+                out.push_back({iter->time,{1.0/iter->open, 1.0/iter->low, 1.0/iter->high, 1.0/iter->close}});
+            } else {
+                out.push_back({iter->time,{iter->open, iter->high, iter->low, iter->close}});
+            }
+        }
+        return out;
+    }
     interval *= 60000; //60milliseconds
     std::uint64_t tm = 0;
     double last = 0;
@@ -1529,7 +1677,7 @@ json::Value MTrader::getOHLC(std::uint64_t interval) const {
         if (minfo.invert_price) v = 1.0/v;
         std::size_t x = static_cast<std::size_t>(item.time/interval);
         if (tm != x) {
-            if (tm) {
+            if (tm && tm*interval >= after) {
                 out.push_back({tm*interval,{ohlc[0],ohlc[1],ohlc[2],ohlc[3]}});
             }
             tm = x;
@@ -1545,7 +1693,7 @@ json::Value MTrader::getOHLC(std::uint64_t interval) const {
             last = v;
         }
     }
-    if (tm) {
+    if (tm && tm*interval >= after) {
         out.push_back({tm*interval,{ohlc[0],ohlc[1],ohlc[2],ohlc[3]}});
     }
     return out;
@@ -8,9 +8,11 @@
 #ifndef SRC_MAIN_MTRADER_H_
 #define SRC_MAIN_MTRADER_H_
 #include <deque>
+#include <memory>
 #include <optional>
 #include <type_traits>
 #include <limits>
+#include <unordered_map>
 
 #include <shared/ini_config.h>
 #include <imtjson/namedEnum.h>
@@ -25,6 +27,8 @@
 #include "strategy.h"
 #include "walletDB.h"
 #include "alert.h"
+#include "ohlcrollup.h"
+#include "ringbuffer.h"
 
 class IStockApi;
 
@@ -134,11 +138,14 @@ public:
 	bool need_init() const;
 
 	OrderPair getOrders();
+	OrderPair getOrders(const IStockApi::Orders &data);
 	void setOrder(std::optional<IStockApi::Order> &orig, Order neworder, std::optional<AlertInfo> &alert, bool secondary);
 
 
 	using ChartItem = IStatSvc::ChartItem;
 	using Chart = std::vector<ChartItem>;
+	///Chart held by the trader, its copy shares the data (see SharedSeries)
+	using ChartBuffer = RingBuffer<ChartItem>;
 
 
 	struct Status {
@@ -167,6 +174,7 @@ public:
 	};
 
 	Status getMarketStatus() const;
+	Status getMarketStatus(const IStockApi::Snapshot &snapshot) const;
 
     bool calculateOrderFeeLessAdjust(Order &order,double assets, double currency,
             int dir, bool alert, double asset_fees, bool no_leverage_check = false) const;
@@ -199,9 +207,66 @@ public:
 
 	const TradeHistory &getTrades() const;
 
+	///Immutable copy of the trader's data for read only requests
+	/**
+	 * Snapshot is published at the end of every cycle and by every method which changes
+	 * the trader. It can be read without locking the trader, so the requests are not
+	 * blocked by the running cycle. Chart and OHLC bars share the data with the trader,
+	 * trades are shared with the previous snapshot until they are changed, so
+	 * publishing costs nearly nothing
+	 */
+	struct Snapshot {
+		ChartBuffer chart;
+		OHLCRollup ohlc;
+		std::shared_ptr<const TradeHistory> trades;
+		IStockApi::MarketInfo minfo;
+		Strategy strategy{nullptr};
+		PStockApi broker;
+		std::string broker_name;
+		std::string pairsymb;
+		std::optional<double> currency;
+		///trader has been initialized (state loaded, market info retrieved)
+		bool loaded = false;
+		double position = 0;
+		double strategy_position = 0;
+		double partial_position = 0;
+		double accumulated = 0;
+		double enter_price = 0;
+		double enter_price_pos = 0;
+		double costs = 0;
+		double rpnl = 0;
+
+		///Retrieves OHLC bars
+		/**
+		 * @param interval interval in minutes
+		 * @param after return bars starting at this time or later (milliseconds). The bar
+		 * at this time is included, because it can be still open
+		 * @return array of bars [time,[open,high,low,close]]
+		 */
+		json::Value getOHLC(std::uint64_t interval, std::uint64_t after = 0) const;
+	};
+
+	using PSnapshot = std::shared_ptr<const Snapshot>;
+
+	///Holds the current snapshot, the snapshot is replaced atomically
+	class SnapshotSlot {
+	public:
+		PSnapshot get() const {return std::atomic_load(&cur);}
+		void set(PSnapshot s) {std::atomic_store(&cur, std::move(s));}
+	protected:
+		PSnapshot cur;
+	};
+
+	using PSnapshotSlot = std::shared_ptr<SnapshotSlot>;
+
+	///Creates new snapshot from the current state and publishes it
+	void publishSnapshot();
+	///Retrieves the slot which holds the current snapshot - the slot can be accessed without locking
+	const PSnapshotSlot &getSnapshotSlot() const {return snapshot_slot;}
+
 
 	Strategy getStrategy() const {return strategy;}
-	void setStrategy(const Strategy &s) {strategy = s;}
+	void setStrategy(const Strategy &s) {strategy = s; publishSnapshot();}
 	void setInternalBalancies(double assets, double currency);
 
 	PStockApi getBroker() const {return stock;}
@@ -237,7 +302,6 @@ public:
 	void fixNorm();
 
 	static PStockApi selectStock(IStockSelector &stock_selector, std::string_view broker_name, SwapMode swap_mode, int emulate_leverage, bool paper_trading);
-	json::Value getOHLC(std::uint64_t interval) const;
 
 	void set_trade_now(bool t) {
 	    trade_now_mode = t;
@@ -268,8 +332,14 @@ protected:
 	using TradeItem = IStockApi::Trade;
 	using TWBItem = IStatSvc::TradeRecord;
 
-	std::vector<ChartItem> chart;
+	ChartBuffer chart;
+	OHLCRollup ohlc;
 	TradeHistory trades;
+	PSnapshotSlot snapshot_slot = std::make_shared<SnapshotSlot>();
+	///trades has been changed since the last snapshot
+	bool trades_changed = true;
+	///index of trades - id (as string) to positions of all trades with the id
+	std::unordered_multimap<std::string, std::size_t> trade_index;
 	clone_ptr<ISpreadGen::State> spread_state;
 
 	double position = 0;
@@ -295,7 +365,27 @@ protected:
 	size_t uid = 0;
 	PerformanceReport tempPr;
 
+	///count of trades already in the storage (journal)
+	std::size_t journal_trades = 0;
+	///time of last chart item already in the storage (journal)
+	std::uint64_t journal_chart_time = 0;
+	///count of updates written to the journal since last full save
+	unsigned int journal_records = 0;
+	///stored data were modified other way than append - full save is needed
+	bool journal_full = true;
+
 	void loadState();
+	json::Value chartItemToJSON(const ChartItem &itm) const;
+	///Count of minutes held in the chart
+	std::size_t chartCapacity() const;
+	///Appends item to the chart and to the OHLC bars
+	void appendChart(const ChartItem &itm);
+	///Appends trade to the history and to the index
+	void addTrade(const TWBItem &itm);
+	///Rebuilds index of trades (after the history has been modified)
+	void rebuildTradeIndex();
+	///Finds trade by id (in string form), returns trades.end() if not found
+	TradeHistory::iterator findTrade(std::string_view id);
 
 
 	bool processTrades(Status &st);
@@ -281,6 +281,43 @@ public:
     }
 };
 
+///Lower bound search starting at the hint
+/**
+ * Useful when many sorted arguments are searched, the result of the previous search is
+ * passed as hint. The search gallops from the hint, so nearby results are found in few steps.
+ * Works for any hint, but it is fast only when the result is near the hint
+ *
+ * @param begin begin of the sorted range
+ * @param end end of the sorted range
+ * @param hint position where to start
+ * @param val value to search
+ * @param cmp comparison function (less)
+ * @return same result as std::lower_bound
+ */
+template<typename Iter, typename T, typename Cmp>
+Iter lower_bound_hint(Iter begin, Iter end, Iter hint, const T &val, Cmp &&cmp) {
+	std::size_t step = 1;
+	if (hint != end && cmp(*hint, val)) {
+		Iter lo = hint+1;
+		while (true) {
+			if (static_cast<std::size_t>(end - lo) <= step) return std::lower_bound(lo, end, val, cmp);
+			Iter probe = lo + step;
+			if (!cmp(*probe, val)) return std::lower_bound(lo, probe, val, cmp);
+			lo = probe+1;
+			step *= 2;
+		}
+	} else {
+		Iter hi = hint;
+		while (true) {
+			if (static_cast<std::size_t>(hi - begin) <= step) return std::lower_bound(begin, hi, val, cmp);
+			Iter probe = hi - step;
+			if (cmp(*probe, val)) return std::lower_bound(probe+1, hi, val, cmp);
+			hi = probe;
+			step *= 2;
+		}
+	}
+}
+
 static constexpr bool isFinite(double x) {
     return (-std::numeric_limits<double>::infinity() < x && x < std::numeric_limits<double>::infinity());
 }
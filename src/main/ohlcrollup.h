@@ -0,0 +1,100 @@
+/*
+ * ohlcrollup.h
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#ifndef SRC_MAIN_OHLCROLLUP_H_
+#define SRC_MAIN_OHLCROLLUP_H_
+
+#include <algorithm>
+#include <cstdint>
+
+#include "sharedseries.h"
+
+///OHLC bars of common intervals, updated incrementally by every new price
+/**
+ * Open price of the bar is the close price of the previous bar, so there are no gaps
+ * between bars. Bars are stored in shared chunks, so a copy of the object is cheap
+ */
+class OHLCRollup {
+public:
+
+	struct Bar {
+		std::uint64_t time;
+		double open;
+		double high;
+		double low;
+		double close;
+	};
+
+	using Bars = SharedSeries<Bar>;
+
+	///Maintained intervals in minutes
+	static constexpr unsigned int intervals[] = {5,15,60,240,1440};
+	static constexpr unsigned int interval_count = sizeof(intervals)/sizeof(intervals[0]);
+
+	OHLCRollup() {
+		for (unsigned int i = 0; i < interval_count; i++) series[i].interval = intervals[i]*60000ULL;
+	}
+
+	void clear() {
+		for (auto &s: series) s.bars.clear();
+		last = 0;
+	}
+
+	///Add price
+	/**
+	 * @param time time in milliseconds, must not be less than time of previous price
+	 * @param price price
+	 */
+	void add(std::uint64_t time, double price) {
+		for (auto &s: series) {
+			std::uint64_t t = time/s.interval*s.interval;
+			if (s.bars.empty() || s.bars.back().time != t) {
+				double open = last?last:price;
+				s.bars.push_back({t, open, std::max(open, price), std::min(open, price), price});
+			} else {
+				Bar &b = s.bars.modify_back();
+				b.close = price;
+				b.high = std::max(b.high, price);
+				b.low = std::min(b.low, price);
+			}
+		}
+		last = price;
+	}
+
+	///Removes bars which ended before given time
+	void trim(std::uint64_t time) {
+		for (auto &s: series) {
+			std::size_t n = 0;
+			while (n < s.bars.size() && s.bars[n].time + s.interval <= time) ++n;
+			s.bars.pop_front(n);
+		}
+	}
+
+	///Retrieves bars of the interval
+	/**
+	 * @param interval interval in minutes
+	 * @return pointer to bars or nullptr if the interval is not maintained
+	 */
+	const Bars *get(unsigned int interval) const {
+		for (const auto &s: series) {
+			if (s.interval == interval*60000ULL) return &s.bars;
+		}
+		return nullptr;
+	}
+
+protected:
+	struct Series {
+		std::uint64_t interval;
+		Bars bars;
+	};
+
+	Series series[interval_count];
+	double last = 0;
+};
+
+
+
+#endif /* SRC_MAIN_OHLCROLLUP_H_ */
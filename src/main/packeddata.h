@@ -0,0 +1,55 @@
+/*
+ * packeddata.h
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#ifndef SRC_MAIN_PACKEDDATA_H_
+#define SRC_MAIN_PACKEDDATA_H_
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <imtjson/binary.h>
+#include <imtjson/value.h>
+
+///Packs array of plain values (doubles or structures of doubles) into binary value
+/**
+ * Items are stored as block of memory in the native byte order (little endian on all
+ * supported platforms). The binary json transfers the block as is, the text json
+ * encodes it as base64. In both cases, the numbers are not boxed one by one
+ */
+template<typename T>
+json::Value packData(const std::vector<T> &data) {
+	static_assert(std::is_trivially_copyable_v<T>);
+	return json::Value(json::BinaryView(reinterpret_cast<const unsigned char *>(data.data()), data.size()*sizeof(T)), json::base64);
+}
+
+///Unpacks values packed by the packData()
+/**
+ * @param v packed data
+ * @param out vector receives items (appended). Incomplete item at the end is ignored
+ */
+template<typename T>
+void unpackData(json::Value v, std::vector<T> &out) {
+	static_assert(std::is_trivially_copyable_v<T>);
+	json::Binary b = v.getBinary(json::base64);
+	std::size_t cnt = b.length/sizeof(T);
+	std::size_t pos = out.size();
+	out.resize(pos+cnt);
+	std::memcpy(out.data()+pos, b.data, cnt*sizeof(T));
+}
+
+///Unpacks numbers, accepts both packed data and json array
+inline void unpackNumbers(json::Value v, std::vector<double> &out) {
+	if (v.type() == json::string) {
+		unpackData(v, out);
+	} else {
+		out.reserve(out.size()+v.size());
+		for (json::Value x: v) out.push_back(x.getNumber());
+	}
+}
+
+
+#endif /* SRC_MAIN_PACKEDDATA_H_ */
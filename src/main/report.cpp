@@ -58,14 +58,10 @@ void Report::genReport() {
 
 	if (refresh_after_clear) {
 		refresh_after_clear = false;
-		for (auto &x : streams) {
-			x(nullptr); //< clear cache.
-			x("refresh") && stream_refresh(x) && x("end_refresh");
-		}
+		frame_cache.clear();
+		if (!streams.empty()) broadcast(stream_refresh());
 	} else {
-		for (auto &x : streams) {
-			x("update");
-		}
+		broadcast(createFrame("update"));
 	}
 }
 
@@ -547,13 +543,51 @@ void Report::perfReport(json::Value report) {
 }
 
 void Report::sendStream(const json::Value &v) {
-	if (refresh_after_clear) return;
+	if (refresh_after_clear || streams.empty()) return;
+	if (isDuplicate(v)) return;
+	broadcast(createFrame(v));
+}
+
+void Report::broadcast(const StreamFrame &frame) {
+	auto iter = std::remove_if(streams.begin(), streams.end(), [&](const auto &s){
+		return !s(frame);
+	});
+	streams.erase(iter, streams.end());
+}
+
+void Report::broadcast(const FrameList &frames) {
 	auto iter = std::remove_if(streams.begin(), streams.end(), [&](const auto &s){
-		return !s(v);
+		return !sendFrames(s, frames);
 	});
 	streams.erase(iter, streams.end());
 }
 
+bool Report::sendFrames(const Stream &stream, const FrameList &frames) {
+	for (const auto &f: frames) {
+		if (!stream(f)) return false;
+	}
+	return true;
+}
+
+bool Report::isDuplicate(const json::Value &v) {
+	json::Value ty = v.filter([](const json::Value &x){return x.getKey() != "data";});
+	if (ty.empty()) return false;
+	std::hash<json::Value> h;
+	std::size_t hk = h(ty);
+	std::size_t hv = h(v);
+	std::size_t &z = frame_cache[hk];
+	if (z == hv) return true;
+	z = hv;
+	return false;
+}
+
+Report::StreamFrame Report::createFrame(const json::Value &v) {
+	std::string out("data: ");
+	v.serialize([&](char c){out.push_back(c);});
+	out.append("\r\n\r\n");
+	return std::make_shared<const std::string>(std::move(out));
+}
+
 template<typename ME>
 void Report::sendStreamGlobal(ME &me) const {
 	me.sendStream(Object{
@@ -588,7 +622,7 @@ std::size_t Report::initCounter() {
 void Report::addStream(Stream &&stream) {
 	if (refresh_after_clear) {
 		this->streams.push_back(std::move(stream));
-	} else if (stream("refresh") && stream_refresh(stream) && stream("end_refresh")) {
+	} else if (sendFrames(stream, stream_refresh())) {
 		this->streams.push_back(std::move(stream));
 	}
 }
@@ -625,18 +659,20 @@ void Report::sendLogMessages(ME &me) const {
 	}
 }
 
-bool Report::stream_refresh(Stream &stream) const  {
+Report::FrameList Report::stream_refresh() {
 	class Helper {
 	public:
-		Helper(Stream &stream):stream(stream) {}
+		Helper(Report &owner):owner(owner) {}
 		void sendStream(const Value &x) {
-			ok = ok && stream(x);
+			owner.isDuplicate(x);
+			frames.push_back(createFrame(x));
 		}
-		Stream &stream;
-		bool ok = true;
+		Report &owner;
+		FrameList frames;
 	};
 
-	Helper hlp(stream);
+	Helper hlp(*this);
+	hlp.frames.push_back(createFrame("refresh"));
 	sendStreamGlobal(hlp);
 	for (const auto &item: infoMap) {
 		sendStreamInfo(hlp,item.first, item.second);
@@ -658,5 +694,6 @@ bool Report::stream_refresh(Stream &stream) const  {
 	}
 	sendNewsMessages(hlp);
 	sendLogMessages(hlp);
-	return hlp.ok;
+	hlp.frames.push_back(createFrame("end_refresh"));
+	return std::move(hlp.frames);
 }
@@ -9,8 +9,11 @@
 #define SRC_MAIN_REPORT_H_
 
 #include <imtjson/array.h>
+#include <functional>
+#include <memory>
 #include <string_view>
 #include <optional>
+#include <unordered_map>
 #include "istockapi.h"
 #include "storage.h"
 #include "../shared/linear_map.h"
@@ -37,7 +40,12 @@ class Report {
 
 
 public:
-	using Stream = std::function<bool(json::Value)>;
+	///Event serialized as server-sent-event frame
+	/** The frame is serialized once and shared by all connected streams */
+	using StreamFrame = std::shared_ptr<const std::string>;
+	///Stream receives frames, returns false to unsubscribe
+	using Stream = std::function<bool(const StreamFrame &)>;
+	using FrameList = std::vector<StreamFrame>;
 
 	using StoragePtr = PStorage;
 	using MiscData = IStatSvc::MiscData;
@@ -123,6 +131,11 @@ protected:
 	unsigned int newsMessages = 0;
 
 	void sendStream(const json::Value &v);
+	void broadcast(const StreamFrame &frame);
+	void broadcast(const FrameList &frames);
+	bool isDuplicate(const json::Value &v);
+	static StreamFrame createFrame(const json::Value &v);
+	static bool sendFrames(const Stream &stream, const FrameList &frames);
 
 
 	void exportCharts(json::Object&& out);
@@ -135,11 +148,13 @@ protected:
 	std::size_t counter;
 	std::size_t revize;
 	bool refresh_after_clear;
+	///hash of last value sent for each event key (deduplication)
+	std::unordered_map<std::size_t, std::size_t> frame_cache;
 
 
 	static std::size_t initCounter();
 
-	bool stream_refresh(Stream &stream) const ;
+	FrameList stream_refresh();
 
 
 	template<typename ME> static void sendStreamOrder(ME &me, const OKey &key, const OValue &data);
@@ -0,0 +1,47 @@
+/*
+ * ringbuffer.h
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#ifndef SRC_MAIN_RINGBUFFER_H_
+#define SRC_MAIN_RINGBUFFER_H_
+
+#include <algorithm>
+#include <cstddef>
+
+#include "sharedseries.h"
+
+///Fixed capacity buffer, which drops the oldest item, when a new item is added and the buffer is full
+/**
+ * Memory is allocated as needed up to the capacity. Items are accessible through the random
+ * access iterator in order of insertion. Items are stored in shared chunks (see SharedSeries),
+ * so a copy of the buffer is cheap
+ */
+template<typename T>
+class RingBuffer: public SharedSeries<T> {
+public:
+
+	RingBuffer(std::size_t capacity = 1):cap(std::max<std::size_t>(capacity,1)) {}
+
+	///Changes capacity, when it is lower than size, the oldest items are removed
+	void set_capacity(std::size_t capacity) {
+		cap = std::max<std::size_t>(capacity,1);
+		if (this->size() > cap) this->pop_front(this->size() - cap);
+	}
+
+	std::size_t capacity() const {return cap;}
+
+	///Appends item, removes the oldest item when the buffer is full
+	void push_back(const T &v) {
+		SharedSeries<T>::push_back(v);
+		if (this->size() > cap) this->pop_front();
+	}
+
+protected:
+	std::size_t cap;
+};
+
+
+
+#endif /* SRC_MAIN_RINGBUFFER_H_ */
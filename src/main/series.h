@@ -7,7 +7,9 @@
 
 #ifndef SRC_MAIN_SERIES_H_
 #define SRC_MAIN_SERIES_H_
+#include <algorithm>
 #include <cstddef>
+#include <deque>
 #include <vector>
 #include <optional>
 #include <queue>
@@ -50,47 +52,79 @@ protected:
 
 };
 
+///Best value (min or max) of sliding window
+/**
+ * Uses monotonic deque, every value is added and removed once, so cost is O(1)
+ * amortized per value
+ *
+ * @tparam T type of value
+ * @tparam Cmp comparison, std::greater for maximum, std::less for minimum
+ */
 template<typename T, typename Cmp>
 class StreamBest {
 public:
-	StreamBest(std::size_t interval, Cmp cmp = Cmp()):cmp(cmp),interval(interval) {}
+	StreamBest(std::size_t interval, Cmp cmp = Cmp()):cmp(cmp),interval(std::max<std::size_t>(1,interval)) {}
+	//feed value and return result
 	T operator<<(const T &val);
+	///Feed multiple values
+	/**
+	 * @param values pointer to values
+	 * @param count count of values
+	 * @return best value after last value is processed
+	 */
+	std::optional<T> feed(const T *values, std::size_t count);
+	///Feed multiple values, store result for every value
+	/**
+	 * @param values pointer to values
+	 * @param count count of values
+	 * @param out pointer to output array, it must have space for count items. Can be
+	 * same as values
+	 */
+	void feed(const T *values, std::size_t count, T *out);
 	std::size_t size() const;
 protected:
 	Cmp cmp;
 	std::size_t interval;
-	std::deque<T> data;
-	std::optional<T> best;
+	///total count of values processed
+	std::size_t counter = 0;
+	///candidates (sequence number, value), front is the best
+	std::deque<std::pair<std::size_t, T> > data;
+
+	void push(const T &val);
 };
 
+template<typename T, typename Cmp>
+inline void StreamBest<T, Cmp>::push(const T &val) {
+	while (!data.empty() && !cmp(data.back().second, val)) data.pop_back();
+	data.emplace_back(counter, val);
+	++counter;
+	if (data.front().first + interval < counter) data.pop_front();
+}
+
 template<typename T, typename Cmp>
 inline T StreamBest<T, Cmp>::operator <<(const T &val) {
-	if (!best.has_value()) best = val;
-	else if (cmp(val, *best)) {
-		best = val;
-		data.push_back(val);
-		if (data.size()>interval) data.pop_front();
-	} else {
-		data.push_back(val);
-		if (data.size() > interval) {
-			const T &l = data.front();
-			bool findmax = l == *best;
-			data.pop_front();
-			if (findmax) {
-				T curBest = val;
-				for (const T &x: data) {
-					if (cmp(x, curBest)) curBest = x;
-				}
-				best = curBest;
-			}
-		}
+	push(val);
+	return data.front().second;
+}
+
+template<typename T, typename Cmp>
+inline std::optional<T> StreamBest<T, Cmp>::feed(const T *values, std::size_t count) {
+	for (std::size_t i = 0; i < count; i++) push(values[i]);
+	if (data.empty()) return std::optional<T>();
+	else return data.front().second;
+}
+
+template<typename T, typename Cmp>
+inline void StreamBest<T, Cmp>::feed(const T *values, std::size_t count, T *out) {
+	for (std::size_t i = 0; i < count; i++) {
+		push(values[i]);
+		out[i] = data.front().second;
 	}
-	return *best;
 }
 
 template<typename T, typename Cmp>
 inline std::size_t StreamBest<T, Cmp>::size() const {
-	return data.size();
+	return std::min(counter, interval);
 }
 
 #endif /* SRC_MAIN_SERIES_H_ */
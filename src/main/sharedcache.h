@@ -0,0 +1,106 @@
+/*
+ * sharedcache.h
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#ifndef SRC_MAIN_SHAREDCACHE_H_
+#define SRC_MAIN_SHAREDCACHE_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+///Thread safe cache of immutable shared objects
+/**
+ * Objects are created by a factory on first request and shared by all consumers. When
+ * the cache is full, the least recently used object is removed from the cache (the object is
+ * destroyed once the last consumer releases it)
+ *
+ * @tparam Key key type, must be ordered
+ * @tparam T type of cached object
+ */
+template<typename Key, typename T>
+class SharedCache {
+public:
+
+	using PObject = std::shared_ptr<const T>;
+
+	struct Stats {
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::size_t evictions = 0;
+		std::size_t size = 0;
+	};
+
+	SharedCache(std::size_t max_size):max_size(max_size) {}
+
+	///Retrieve object from the cache, create it, when it is not there
+	/**
+	 * @param key key
+	 * @param factory function which creates the object (returns std::shared_ptr<T>). It
+	 * is called outside of the lock, so it can take a long time.
+	 * @return shared object
+	 */
+	template<typename Fn>
+	PObject get(const Key &key, Fn &&factory) {
+		{
+			std::lock_guard _(lock);
+			auto iter = items.find(key);
+			if (iter != items.end()) {
+				++stats.hits;
+				iter->second.last_use = ++counter;
+				return iter->second.obj;
+			}
+			++stats.misses;
+		}
+		PObject obj = factory();
+		std::lock_guard _(lock);
+		//object could be created by other thread meanwhile, the first wins
+		auto ins = items.emplace(key, Item{obj, ++counter});
+		if (ins.second) {
+			while (items.size() > max_size) evict();
+		}
+		return ins.first->second.obj;
+	}
+
+	///Retrieve statistics
+	Stats getStats() const {
+		std::lock_guard _(lock);
+		Stats r = stats;
+		r.size = items.size();
+		return r;
+	}
+
+	///Remove all objects
+	void clear() {
+		std::lock_guard _(lock);
+		items.clear();
+	}
+
+protected:
+
+	struct Item {
+		PObject obj;
+		std::size_t last_use;
+	};
+
+	mutable std::mutex lock;
+	std::map<Key, Item> items;
+	std::size_t max_size;
+	std::size_t counter = 0;
+	Stats stats;
+
+	void evict() {
+		auto found = items.begin();
+		for (auto iter = items.begin(); iter != items.end(); ++iter) {
+			if (iter->second.last_use < found->second.last_use) found = iter;
+		}
+		items.erase(found);
+		++stats.evictions;
+	}
+};
+
+
+
+#endif /* SRC_MAIN_SHAREDCACHE_H_ */
@@ -0,0 +1,150 @@
+/*
+ * sharedseries.h
+ *
+ *  Created on: 18. 10. 2026
+ */
+
+#ifndef SRC_MAIN_SHAREDSERIES_H_
+#define SRC_MAIN_SHAREDSERIES_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+///Sequence of items stored in chunks, which are shared between copies
+/**
+ * Copy of the series shares chunks with the original, so it costs a copy of few pointers
+ * regardless of the count of items. A chunk is modified only when it is not shared, otherwise
+ * it is copied first (copy on write). So the copy can be passed to an other thread and read
+ * there while the original is being modified.
+ *
+ * Items can be appended at the end, modified and removed from the beginning
+ *
+ * @tparam T type of item
+ * @tparam chunk_size count of items in one chunk
+ */
+template<typename T, std::size_t chunk_size = 256>
+class SharedSeries {
+public:
+
+	class const_iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T *;
+		using reference = const T &;
+
+		const_iterator():owner(nullptr),idx(0) {}
+		const_iterator(const SharedSeries *owner, std::size_t idx):owner(owner),idx(idx) {}
+
+		reference operator*() const {return (*owner)[idx];}
+		pointer operator->() const {return &(*owner)[idx];}
+		reference operator[](difference_type n) const {return (*owner)[idx+n];}
+		const_iterator &operator++() {++idx;return *this;}
+		const_iterator &operator--() {--idx;return *this;}
+		const_iterator operator++(int) {auto x = *this; ++idx; return x;}
+		const_iterator operator--(int) {auto x = *this; --idx; return x;}
+		const_iterator &operator+=(difference_type n) {idx+=n;return *this;}
+		const_iterator &operator-=(difference_type n) {idx-=n;return *this;}
+		const_iterator operator+(difference_type n) const {return const_iterator(owner, idx+n);}
+		const_iterator operator-(difference_type n) const {return const_iterator(owner, idx-n);}
+		friend const_iterator operator+(difference_type n, const const_iterator &x) {return x+n;}
+		difference_type operator-(const const_iterator &other) const {
+			return static_cast<difference_type>(idx) - static_cast<difference_type>(other.idx);
+		}
+		bool operator==(const const_iterator &other) const {return idx == other.idx;}
+		bool operator!=(const const_iterator &other) const {return idx != other.idx;}
+		bool operator<(const const_iterator &other) const {return idx < other.idx;}
+		bool operator>(const const_iterator &other) const {return idx > other.idx;}
+		bool operator<=(const const_iterator &other) const {return idx <= other.idx;}
+		bool operator>=(const const_iterator &other) const {return idx >= other.idx;}
+	protected:
+		const SharedSeries *owner;
+		std::size_t idx;
+	};
+
+	std::size_t size() const {return count;}
+	bool empty() const {return count == 0;}
+
+	const T &operator[](std::size_t idx) const {
+		idx += skip;
+		return (*chunks[idx / chunk_size])[idx % chunk_size];
+	}
+	const T &front() const {return (*this)[0];}
+	const T &back() const {return (*this)[count-1];}
+
+	const_iterator begin() const {return const_iterator(this, 0);}
+	const_iterator end() const {return const_iterator(this, count);}
+
+	void push_back(const T &v) {
+		if ((skip + count) % chunk_size == 0) {
+			auto c = std::make_shared<Chunk>();
+			c->reserve(chunk_size);
+			chunks.push_back(std::move(c));
+		} else {
+			own(chunks.back());
+		}
+		chunks.back()->push_back(v);
+		++count;
+	}
+
+	///Retrieves item for modification, the chunk is copied when it is shared
+	T &modify(std::size_t idx) {
+		idx += skip;
+		PChunk &c = chunks[idx / chunk_size];
+		own(c);
+		return (*c)[idx % chunk_size];
+	}
+
+	T &modify_back() {return modify(count-1);}
+
+	///Removes items from the beginning
+	void pop_front(std::size_t n = 1) {
+		n = std::min(n, count);
+		count -= n;
+		if (count == 0) {
+			clear();
+		} else {
+			skip += n;
+			std::size_t rm = skip / chunk_size;
+			chunks.erase(chunks.begin(), chunks.begin()+rm);
+			skip -= rm * chunk_size;
+		}
+	}
+
+	void clear() {
+		chunks.clear();
+		skip = 0;
+		count = 0;
+	}
+
+protected:
+	using Chunk = std::vector<T>;
+	using PChunk = std::shared_ptr<Chunk>;
+
+	std::vector<PChunk> chunks;
+	///count of removed items in the first chunk
+	std::size_t skip = 0;
+	std::size_t count = 0;
+
+	///Makes the chunk private to this series
+	static void own(PChunk &c) {
+		if (c.use_count() != 1) {
+			auto n = std::make_shared<Chunk>();
+			n->reserve(chunk_size);
+			n->assign(c->begin(), c->end());
+			c = std::move(n);
+		} else {
+			//the last copy could be released in other thread, its reads must finish before we write
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+	}
+};
+
+
+
+#endif /* SRC_MAIN_SHAREDSERIES_H_ */
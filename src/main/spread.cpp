@@ -24,7 +24,6 @@ public:
 	public:
 		StreamSMA sma;
 		StreamSTDEV stdev;
-		StreamBest<double, std::greater<double> > maxSpread;
 
 		State(std::size_t sma_interval,std::size_t stdev_interval);
 	    virtual ISpreadState *clone() const {
@@ -91,7 +90,7 @@ DefaulSpread::Result DefaulSpread::point(std::unique_ptr<ISpreadState> &state, d
 }
 
 inline DefaulSpread::State::State(std::size_t sma_interval, std::size_t stdev_interval)
-	:sma(sma_interval), stdev(stdev_interval),maxSpread(10)
+	:sma(sma_interval), stdev(stdev_interval)
 {
 
 }
@@ -8,18 +8,25 @@
 #include "storage.h"
 
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <shared/filesystem.h>
 #include <stack>
 
+#include <imtjson/array.h>
 #include <imtjson/binjson.tcc>
+#include <imtjson/object.h>
 #include <unistd.h>
 
 #include "../shared/logOutput.h"
 
 using namespace std::filesystem;
 
-Storage::Storage(std::string file, int versions, Format format):file(file),versions(versions),format(format) {
+///Name of the key which contains sequence number of the last journal record included in the data
+static const char *journal_key = "_journal";
+
+Storage::Storage(std::string file, int versions, Format format, bool journal)
+	:file(file),versions(versions),format(format),journal(journal) {
 }
 
 std::stack<std::string> Storage::generateNames() {
@@ -34,6 +41,10 @@ std::stack<std::string> Storage::generateNames() {
 }
 
 void Storage::store(json::Value data) {
+	if (journal) {
+		if (journal_seq == 0) journal_seq = 1;
+		data = data.replace(journal_key, journal_seq);
+	}
 	std::string tmpname = file+".tmp";
 	std::ofstream f(tmpname, std::ios::out|std::ios::trunc);
 	if (!f) {
@@ -67,6 +78,62 @@ void Storage::store(json::Value data) {
 		to = from;
 	}
 	rename(tmpname, to);
+	//all records are now part of the data, clear the journal
+	if (journal) std::remove((file+".journal").c_str());
+}
+
+bool Storage::update(json::Value set, json::Value append) {
+	//sequence must be known, otherwise full store is needed
+	if (!journal || journal_seq == 0) return false;
+	std::ofstream f(file+".journal", std::ios::out|std::ios::app);
+	if (!f) return false;
+	json::Value rec = json::Object({
+		{"seq", journal_seq+1},
+		{"set", set},
+		{"append", append}
+	});
+	//one record per line, partially written line is ignored during replay
+	rec.toStream(f);
+	f << std::endl;
+	if (!f) return false;
+	++journal_seq;
+	return true;
+}
+
+void Storage::replayJournal(json::Value &data, std::size_t seq) {
+	std::ifstream f(file+".journal", std::ios::in);
+	journal_seq = seq;
+	if (!f) return;
+	std::map<std::string, json::Array> appended;
+	std::string line;
+	while (std::getline(f, line)) {
+		json::Value rec;
+		try {
+			rec = json::Value::fromString(line);
+		} catch (...) {
+			//damaged journal, force compaction on next update
+			journal_seq = 0;
+			break;
+		}
+		std::size_t rseq = rec["seq"].getUInt();
+		if (rseq <= journal_seq) continue;
+		journal_seq = rseq;
+		for (json::Value v: rec["set"]) {
+			data = data.replace(v.getKey(), v);
+		}
+		for (json::Value v: rec["append"]) {
+			std::string key = v.getKey();
+			auto iter = appended.find(key);
+			if (iter == appended.end()) {
+				iter = appended.emplace(key, json::Array()).first;
+				for (json::Value x: data[key]) iter->second.push_back(x);
+			}
+			for (json::Value x: v) iter->second.push_back(x);
+		}
+	}
+	for (auto &&x: appended) {
+		data = data.replace(x.first, x.second);
+	}
 }
 
 json::Value Storage::load() {
@@ -88,11 +155,20 @@ json::Value Storage::load() {
 		}
 	};
 
+	auto loadJournal=[&](json::Value data) {
+		if (journal && data.defined()) {
+			std::size_t seq = std::max<std::size_t>(1,data[journal_key].getUInt());
+			data = data.replace(journal_key, json::undefined);
+			replayJournal(data, seq);
+		}
+		return data;
+	};
+
 	try {
-		return loadFile(file);
+		return loadJournal(loadFile(file));
 	} catch (...) {
 		try {
-			return loadFile(file+"~1");
+			return loadJournal(loadFile(file+"~1"));
 		} catch (...) {
 			return json::Value();
 		}
@@ -100,7 +176,7 @@ json::Value Storage::load() {
 }
 
 PStorage StorageFactory::create(std::string name) const {
-	return std::make_unique<Storage>(path+"/"+ name, versions, format);
+	return std::make_unique<Storage>(path+"/"+ name, versions, format, journal);
 }
 
 void Storage::erase() {
@@ -109,6 +185,8 @@ void Storage::erase() {
 		std::remove(stack.top().c_str());
 		stack.pop();
 	}
+	std::remove((file+".journal").c_str());
+	journal_seq = 0;
 }
 
 void MemStorage::erase() {
@@ -26,17 +26,24 @@ public:
 	};
 
 
-	Storage(std::string file, int versions, Format format);
+	Storage(std::string file, int versions, Format format, bool journal = false);
 
 	virtual void store(json::Value data) override;
 	virtual json::Value load() override;
 	virtual void erase() override;
+	virtual bool update(json::Value set, json::Value append) override;
 
 
 protected:
 	std::string file;
 	int versions;
 	Format format;
+	///journal is enabled
+	bool journal;
+	///sequence number of the last journal record, 0 = unknown (no load or store yet)
+	std::size_t journal_seq = 0;
+
+	void replayJournal(json::Value &data, std::size_t seq);
 
 	std::stack<std::string> generateNames();
 };
@@ -47,7 +54,8 @@ public:
 
 	StorageFactory(std::string path):path(path),versions(5),format(Storage::json) {}
 	StorageFactory(std::string path, bool binary):path(path),versions(5),format(binary?Storage::binjson:Storage::json) {}
-	StorageFactory(std::string path, int versions, Storage::Format format):path(path),versions(versions),format(format) {}
+	StorageFactory(std::string path, int versions, Storage::Format format, bool journal = false)
+		:path(path),versions(versions),format(format),journal(journal) {}
 	virtual PStorage create(std::string name) const override;
 
 
@@ -55,6 +63,7 @@ protected:
 	std::string path;
 	int versions;
 	Storage::Format format;
+	bool journal = false;
 };
 
 class MemStorage: public IStorage {
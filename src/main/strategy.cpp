@@ -164,7 +164,7 @@ Strategy Strategy::create_base(std::string_view id, json::Value config) {
 		return Strategy(new Strategy_KeepBalance(cfg));
 	} else if (id == Strategy_Gamma::id) {
 		Strategy_Gamma::Config cfg;
-		cfg.intTable = std::make_shared<Strategy_Gamma::IntegrationTable>(strGammaFunction[config["function"].getString()],config["exponent"].getNumber());
+		cfg.intTable = Strategy_Gamma::IntegrationTable::create(strGammaFunction[config["function"].getString()],config["exponent"].getNumber());
 		cfg.reduction_mode = config["rebalance"].getInt();
 		cfg.trend= config["trend"].getNumber();
 		cfg.reinvest= config["reinvest"].getNumber();
@@ -188,7 +188,7 @@ Strategy Strategy::create_base(std::string_view id, json::Value config) {
 		return Strategy(new Strategy_Hodl_Short(cfg));
 	} else if (id == "passive_income") {
 		Strategy_Gamma::Config cfg;
-		cfg.intTable = std::make_shared<Strategy_Gamma::IntegrationTable>(Strategy_Gamma::Function::halfhalf,config["exponent"].getNumber());
+		cfg.intTable = Strategy_Gamma::IntegrationTable::create(Strategy_Gamma::Function::halfhalf,config["exponent"].getNumber());
 		cfg.reduction_mode = 4;
 		cfg.trend= 0;
 		cfg.reinvest=false;
@@ -201,7 +201,7 @@ Strategy Strategy::create_base(std::string_view id, json::Value config) {
 		double w = config["w"].getNumber();
 		double b = config["b"].getNumber();
 		double z = -cfg.disableSide?0:config["z"].getNumber()*0.002;
-		cfg.calc = std::make_shared<Strategy_Sinh_Gen::FnCalc>(w,b*0.01,z);
+		cfg.calc = Strategy_Sinh_Gen::FnCalc::create(w,b*0.01,z);
 		cfg.power = p;
 		cfg.reinvest = config["reinvest"].getBool();
 		cfg.avgspread= config["avgspread"].getBool();
@@ -248,6 +248,23 @@ Strategy Strategy::create(std::string_view id, json::Value config) {
 }
 
 
+template<typename Stats>
+static json::Value cacheStatsToJSON(const Stats &st) {
+	return json::Object({
+		{"hits", st.hits},
+		{"misses", st.misses},
+		{"evictions", st.evictions},
+		{"size", st.size}
+	});
+}
+
+json::Value Strategy::getCacheStats() {
+	return json::Object({
+		{"gamma", cacheStatsToJSON(Strategy_Gamma::IntegrationTable::cacheStats())},
+		{"sinh_gen", cacheStatsToJSON(Strategy_Sinh_Gen::FnCalc::cacheStats())}
+	});
+}
+
 json::Value Strategy::exportState() const {
 	return json::Object({{ptr->getID(), ptr->exportState()}});
 }
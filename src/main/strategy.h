@@ -125,6 +125,18 @@ public:
 		return ptr->calcChart(price);
 	}
 
+	///Calculates chart for many prices at once (see IStrategy::calcChartBatch)
+	void calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const {
+		ptr->calcChartBatch(prices, count, out);
+	}
+
+	///Calculates chart for many prices at once
+	std::vector<IStrategy::ChartPoint> calcChartBatch(const std::vector<double> &prices) const {
+		std::vector<IStrategy::ChartPoint> out(prices.size());
+		ptr->calcChartBatch(prices.data(), prices.size(), out.data());
+		return out;
+	}
+
 	double getCenterPrice(double lastPrice, double assets) const {
 		return ptr->getCenterPrice(lastPrice,assets);
 	}
@@ -142,6 +154,8 @@ public:
 
 	static Strategy create_base(std::string_view id, json::Value config);
 	static Strategy create(std::string_view id, json::Value config);
+	///Retrieves statistics of shared integration table caches
+	static json::Value getCacheStats();
 
 	Strategy invert() const;
 
@@ -401,6 +401,17 @@ IStrategy::ChartPoint Strategy_Exponencial::calcChart(double price) const {
     };
 }
 
+void Strategy_Exponencial::calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const {
+    const MathModule &m = *mcfg;
+    for (std::size_t i = 0; i < count; i++) {
+        out[i] = {
+            true,
+            m.calcPos(prices[i], st.k, st.m),
+            m.calcEquity(prices[i], st.k, st.m)
+        };
+    }
+}
+
 json::Value Strategy_Exponencial::dumpStatePretty(const IStockApi::MarketInfo &minfo) const {
     auto price = [&](double x){return minfo.invert_price?1.0/x:x;};
     auto position = [&](double x){return minfo.invert_price?-x:x;};
@@ -97,6 +97,7 @@ public:
     virtual IStrategy::BudgetInfo getBudgetInfo() const override;
     virtual double getEquilibrium(double assets) const override;
     virtual IStrategy::ChartPoint calcChart(double price) const override;
+    virtual void calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const override;
     virtual PStrategy onIdle(const IStockApi::MarketInfo &minfo,
             const IStockApi::Ticker &curTicker, double assets,
             double currency) const override;
@@ -241,6 +241,22 @@ IStrategy::ChartPoint Strategy_Gamma::calcChart(double price) const {
 	};
 }
 
+void Strategy_Gamma::calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const {
+	const IntegrationTable &tb = *cfg.intTable;
+	std::vector<double> x(count), b(count);
+	double k = state.kk;
+	double w = state.w;
+	for (std::size_t i = 0; i < count; i++) x[i] = prices[i]/k;
+	tb.get(x.data(), count, b.data());
+	for (std::size_t i = 0; i < count; i++) {
+		out[i] = {
+			true,
+			tb.mainFunction(x[i])*w/k,
+			std::max(b[i]*w, 0.0)
+		};
+	}
+}
+
 PStrategy Strategy_Gamma::onIdle(const IStockApi::MarketInfo &minfo,
 		const IStockApi::Ticker &curTicker, double assets,
 		double currency) const {
@@ -296,6 +312,19 @@ Strategy_Gamma::IntegrationTable::IntegrationTable(Function fn, double z):fn(fn)
 	logInfo("Integration lookup table: $1 points", values.size());
 }
 
+///Tables are shared between strategies, keep last 64 tables
+static Strategy_Gamma::IntegrationTable::Cache intTableCache(64);
+
+std::shared_ptr<const Strategy_Gamma::IntegrationTable> Strategy_Gamma::IntegrationTable::create(Function fn, double z) {
+	return intTableCache.get({fn, z}, [&]{
+		return std::make_shared<IntegrationTable>(fn, z);
+	});
+}
+
+Strategy_Gamma::IntegrationTable::Cache::Stats Strategy_Gamma::IntegrationTable::cacheStats() {
+	return intTableCache.getStats();
+}
+
 double Strategy_Gamma::IntegrationTable::get(double x) const {
 	//for values below a, use half-half aproximation (square root)
 	if (x <= a) {
@@ -323,6 +352,27 @@ double Strategy_Gamma::IntegrationTable::get(double x) const {
 	}
 }
 
+void Strategy_Gamma::IntegrationTable::get(const double *x, std::size_t count, double *out) const {
+	//search of each argument starts at result of previous argument
+	auto hint = values.begin();
+	for (std::size_t i = 0; i < count; i++) {
+		double v = x[i];
+		if (v <= a) {
+			out[i] = get(v);
+			continue;
+		}
+		auto iter = lower_bound_hint(values.begin(), values.end(), hint, std::pair(v,0.0), std::less<std::pair<double,double> >());
+		hint = iter;
+		if (iter == values.begin()) out[i] = iter->second;
+		else if (iter == values.end()) out[i] = values.back().second;
+		else {
+			const auto &l = *(iter-1);
+			const auto &u = *(iter);
+			out[i] = l.second+(u.second-l.second)*(v - l.first)/(u.first - l.first);
+		}
+	}
+}
+
 
 Strategy_Gamma::NNRes Strategy_Gamma::calculateNewNeutral(double a, double price, double min_order_size) const {
 	if ((price-state.k)*(state.p - state.k) < 0) {
@@ -9,6 +9,7 @@
 #define SRC_MAIN_STRATEGY_GAMMA_H_
 
 #include "istrategy.h"
+#include "sharedcache.h"
 
 class Strategy_Gamma: public IStrategy {
 public:
@@ -29,7 +30,15 @@ public:
 		std::vector<std::pair<double, double> > values;
 		IntegrationTable(Function fn, double z);
 
+		using Cache = SharedCache<std::pair<Function, double>, IntegrationTable>;
+		///Retrieves shared table from the process-wide cache (creates it when needed)
+		static std::shared_ptr<const IntegrationTable> create(Function fn, double z);
+		///Retrieves statistics of the cache
+		static Cache::Stats cacheStats();
+
 		double get(double x) const;
+		///Calculates get() for many arguments, faster when arguments are ascending
+		void get(const double *x, std::size_t count, double *out) const;
 		double get_max() const;
 		double get_min() const;
 
@@ -43,7 +52,7 @@ public:
 
 
 	struct Config {
-		std::shared_ptr<IntegrationTable> intTable;
+		std::shared_ptr<const IntegrationTable> intTable;
 		int reduction_mode;
 		double trend;
 		bool reinvest;
@@ -92,6 +101,7 @@ public:
 	virtual double getEquilibrium(double assets) const override;
 	virtual double calcCurrencyAllocation(double price, bool leveraged) const override;
 	virtual IStrategy::ChartPoint calcChart(double price) const override;
+	virtual void calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const override;
 	virtual PStrategy onIdle(const IStockApi::MarketInfo &minfo,
 			const IStockApi::Ticker &curTicker, double assets,
 			double currency) const override;
@@ -250,6 +250,18 @@ IStrategy::ChartPoint Strategy_DCAM<BaseFn>::calcChart(double price) const {
     };
 }
 
+template<typename BaseFn>
+void Strategy_DCAM<BaseFn>::calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const {
+    double k = _state._k;
+    for (std::size_t i = 0; i < count; i++) {
+        out[i] = {
+            true,
+            calc_position(_cfg, k, prices[i]),
+            calc_value(_cfg, k, prices[i]) + _cfg.initial_budget
+        };
+    }
+}
+
 template<typename BaseFn>
 double Strategy_DCAM<BaseFn>::calc_order(double price, double side) const {
     RuleResult r = find_k_rule(price);
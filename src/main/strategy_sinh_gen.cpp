@@ -54,6 +54,19 @@ Strategy_Sinh_Gen::FnCalc::FnCalc(double wd, double boost,  double z)
 		logInfo("Strategy_Sinh_Gen: Integration table for: wd=$1, entries: $2", wd, itable.size());
 }
 
+///Calculators are shared between strategies, keep last 64 calculators
+static Strategy_Sinh_Gen::FnCalc::Cache fnCalcCache(64);
+
+std::shared_ptr<const Strategy_Sinh_Gen::FnCalc> Strategy_Sinh_Gen::FnCalc::create(double wd, double boost, double z) {
+	return fnCalcCache.get({wd, boost, z}, [&]{
+		return std::make_shared<FnCalc>(wd, boost, z);
+	});
+}
+
+Strategy_Sinh_Gen::FnCalc::Cache::Stats Strategy_Sinh_Gen::FnCalc::cacheStats() {
+	return fnCalcCache.getStats();
+}
+
 double Strategy_Sinh_Gen::FnCalc::baseFn(double x) const {
 	double y;
 	double arg = wd*(1-x);
@@ -106,6 +119,21 @@ double Strategy_Sinh_Gen::FnCalc::integralBaseFn(double x) const {
 
 }
 
+void Strategy_Sinh_Gen::FnCalc::integralBaseFn(const double *x, std::size_t count, double *out) const {
+	//search of each argument starts at result of previous argument
+	auto hint = itable.begin();
+	for (std::size_t i = 0; i < count; i++) {
+		auto iter = lower_bound_hint(itable.begin(), itable.end(), hint, Point(x[i],0), sortPoints);
+		hint = iter;
+		if (iter == itable.begin()) ++iter;
+		else if (iter == itable.end()) --iter;
+		const Point &p1 = *(iter-1);
+		const Point &p2 = *iter;
+		double f = (x[i] - p1.first)/(p2.first - p1.first);
+		out[i] = p1.second + (p2.second - p1.second) * f;
+	}
+}
+
 double Strategy_Sinh_Gen::FnCalc::assets(double k, double w, double x) const {
 	return baseFn(x/k)*w;
 }
@@ -667,6 +695,21 @@ IStrategy::ChartPoint Strategy_Sinh_Gen::calcChart(double price) const {
 	};
 }
 
+void Strategy_Sinh_Gen::calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const {
+	const FnCalc &calc = *cfg.calc;
+	std::vector<double> x(count), b(count);
+	double k = st.k;
+	for (std::size_t i = 0; i < count; i++) x[i] = prices[i]/k;
+	calc.integralBaseFn(x.data(), count, b.data());
+	for (std::size_t i = 0; i < count; i++) {
+		out[i] = {
+			true,
+			calc.baseFn(x[i])*pw+st.offset,
+			b[i]*pw*k+st.budget+st.offset * (prices[i] - st.p)
+		};
+	}
+}
+
 double Strategy_Sinh_Gen::getCenterPrice(double lastPrice,double assets) const {
 	if (st.use_last_price) return lastPrice;
 	else return getEquilibrium(assets);
@@ -9,6 +9,8 @@
 #define SRC_MAIN_STRATEGY_SINH_GEN_H_
 
 #include "../imtjson/src/imtjson/value.h"
+#include <tuple>
+#include "sharedcache.h"
 #include "strategy.h"
 
 class Strategy_Sinh_Gen: public IStrategy {
@@ -21,11 +23,19 @@ public:
 	public:
 		FnCalc(double wd, double boost, double z);
 
+		using Cache = SharedCache<std::tuple<double, double, double>, FnCalc>;
+		///Retrieves shared calculator from the process-wide cache (creates it when needed)
+		static std::shared_ptr<const FnCalc> create(double wd, double boost, double z);
+		///Retrieves statistics of the cache
+		static Cache::Stats cacheStats();
+
 		double baseFn(double x) const;
 		double root(double x) const;
 		double root(double k, double w, double x) const;
 		double root_of_k(double p, double w, double x) const;
 		double integralBaseFn(double x) const;
+		///Calculates integralBaseFn() for many arguments, faster when arguments are ascending
+		void integralBaseFn(const double *x, std::size_t count, double *out) const;
 		double assets(double k, double w, double x) const;
 		double budget(double k, double w, double x) const;
 
@@ -42,7 +52,7 @@ public:
 
 	};
 
-	using PFnCalc = std::shared_ptr<FnCalc>;
+	using PFnCalc = std::shared_ptr<const FnCalc>;
 
 	struct Config {
 		double power;
@@ -104,6 +114,7 @@ public:
 	virtual double getCenterPrice(double lastPrice, double assets) const
 			override;
 	virtual IStrategy::ChartPoint calcChart(double price) const override;
+	virtual void calcChartBatch(const double *prices, std::size_t count, IStrategy::ChartPoint *out) const override;
 	virtual double calcCurrencyAllocation(double price, bool leveraged) const override;
 	virtual IStrategy::BudgetInfo getBudgetInfo() const override;
 	virtual double calcInitialPosition(const IStockApi::MarketInfo &minfo,
@@ -22,7 +22,8 @@
 using ondra_shared::Countdown;
 using ondra_shared::logError;
 NamedMTrader::NamedMTrader(IStockSelector &sel, StoragePtr &&storage, PStatSvc statsvc, const WalletCfg &wcfg, Config cfg, std::string &&name)
-		:MTrader(sel, std::move(storage), std::move(statsvc), wcfg, cfg), ident(std::move(name)) {
+		:MTrader(sel, std::move(storage), std::move(statsvc), wcfg, cfg), ident(std::move(name))
+		,broker_group(cfg.broker.substr(0, cfg.broker.find('~'))) {
 }
 
 void NamedMTrader::perform(bool manually) {
@@ -34,6 +35,7 @@ void NamedMTrader::perform(bool manually) {
 	} catch (std::exception &e) {
 		logError("$1", e.what());
 	}
+	publishSnapshot();
 }
 
 
@@ -127,7 +129,12 @@ sf(sf)
 }
 
 void Traders::clear() {
+	for (const auto &t: traders) {
+		t.second.lock()->retired = true;
+	}
+	snapshots.clear();
 	traders.clear();
+	broker_utilization.clear();
 	stockSelector.clear();
 	wcfg.walletDB = wcfg.walletDB.make();
 	wcfg.accumDB = wcfg.accumDB.make();
@@ -146,6 +153,14 @@ json::Value Traders::getUtilization(std::size_t lastUpdate) const {
 	}
 	res.set("traders", ids);
 	res.set("reset",reset_time);
+	res.set("round",round_time);
+	res.set("round_traders",round_traders);
+	json::Object brokers;
+	for (const auto &x: broker_utilization) {
+		brokers.set(x.first, x.second);
+	}
+	res.set("brokers", brokers);
+	res.set("strategy_cache", Strategy::getCacheStats());
 	res.set("updated", updated);
 	res.set("last_update", lastTime);
 	return res;
@@ -185,6 +200,7 @@ void Traders::addTrader(const MTrader::Config &mcfg ,ondra_shared::StrViewA n) {
 			} catch (...) {
 				//ignore exception now
 			}
+			snapshots.insert(std::pair(StrViewA(lt->ident), lt->getSnapshotSlot()));
 			traders.insert(std::pair(StrViewA(lt->ident), std::move(t)));
 		} else {
 			throw std::runtime_error("Unable to load broker");
@@ -202,6 +218,8 @@ void Traders::removeTrader(ondra_shared::StrViewA n, bool including_state) {
     auto tr = find(n);
 	if (tr != nullptr) {
 	    auto t = tr.lock();
+	    //trader can be still scheduled in the running round
+	    t->retired = true;
 		if (including_state) {
 			//stop trader
 			t->stop();
@@ -213,6 +231,7 @@ void Traders::removeTrader(ondra_shared::StrViewA n, bool including_state) {
 			utilization.erase(n);
 			//now we can erase
 		}
+		snapshots.erase(n);
 		traders.erase(n);
 	}
 }
@@ -230,6 +249,15 @@ void Traders::report_util(std::string_view ident, double ms) {
 			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()};
 }
 
+void Traders::report_broker_util(std::string_view broker, double ms) {
+	broker_utilization[std::string(broker)] = ms;
+}
+
+void Traders::report_round(double ms, std::size_t count) {
+	round_time = ms;
+	round_traders = count;
+}
+
 void Traders::resetBrokers() {
 	auto t1 = std::chrono::system_clock::now();
 	for (const auto &t: traders) {
@@ -256,6 +284,12 @@ shared_lockable_ptr<NamedMTrader> Traders::find(std::string_view id) const {
 	else return iter->second;
 }
 
+MTrader::PSnapshot Traders::getSnapshot(std::string_view id) const {
+	auto iter = snapshots.find(id);
+	if (iter == snapshots.end()) return nullptr;
+	else return iter->second->get();
+}
+
 StockSelector::StockSelector() {
 	temp_markets = temp_markets.make();
 }
@@ -24,6 +24,10 @@ public:
 	NamedMTrader(IStockSelector &sel, StoragePtr &&storage, PStatSvc statsvc, const WalletCfg &wcfg, Config cfg, std::string &&name);
 	void perform(bool manually);
 	const std::string ident;
+	///name of the broker process (without subaccount) - traders of the same group are performed serially
+	const std::string broker_group;
+	///trader has been removed from the list, it must not perform in the running round
+	bool retired = false;
 
 };
 
@@ -53,7 +57,10 @@ class Traders {
 public:
 
 	using TMap = ondra_shared::linear_map<std::string_view, shared_lockable_ptr<NamedMTrader> >;
+	using SnapshotMap = ondra_shared::linear_map<std::string_view, MTrader::PSnapshotSlot>;
 	TMap traders;
+	///snapshots of the traders - they can be read without locking the trader
+	SnapshotMap snapshots;
     StockSelector stockSelector;
 	PStorageFactory &sf;
 	PReport rpt;
@@ -81,6 +88,8 @@ public:
 
 
 	void report_util(std::string_view ident, double ms);
+	void report_broker_util(std::string_view broker, double ms);
+	void report_round(double ms, std::size_t count);
 
 	template<typename Fn>
 	void enumTraders(Fn &&fn) const {
@@ -89,13 +98,20 @@ public:
 
 	void resetBrokers();
 	shared_lockable_ptr<NamedMTrader> find(std::string_view id) const;
+	///Retrieves last published snapshot of the trader, returns nullptr if the trader doesn't exist
+	MTrader::PSnapshot getSnapshot(std::string_view id) const;
 	WalletCfg wcfg;
 
 
 	using Utilization = std::unordered_map<std::string, std::pair<double,std::size_t> >;
 	double reset_time;
+	///wall time of the last round (all traders)
+	double round_time = 0;
+	///count of traders performed in the last round
+	std::size_t round_traders = 0;
 
 	Utilization utilization;
+	std::unordered_map<std::string, double> broker_utilization;
 
 	json::Value getUtilization(std::size_t lastUpdate) const;
 
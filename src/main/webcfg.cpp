@@ -8,7 +8,9 @@
 
 #include "webcfg.h"
 
+#include <atomic>
 #include <random>
+#include <thread>
 #include <unordered_set>
 
 #include <imtjson/array.h>
@@ -24,8 +26,11 @@
 #include "../server/src/simpleServer/urlencode.h"
 #include "../shared/ini_config.h"
 #include "../shared/logOutput.h"
+#include "../shared/worker.h"
 #include "apikeys.h"
 #include "ext_stockapi.h"
+#include "histcache.h"
+#include "packeddata.h"
 #include "random_chart.h"
 #include "sgn.h"
 #include "spread.h"
@@ -65,7 +70,8 @@ WebCfg::WebCfg( const shared_lockable_ptr<State> &state,
 		json::PJWTCrypto jwt,
 		shared_lockable_ptr<AbstractExtern> backtest_broker,
 		std::size_t upload_limit,
-        std::size_t share_limit
+        std::size_t share_limit,
+        std::string tick_import_path
 )
 	:auth(realm, state.lock_shared()->users.admins,jwt, false)
 	,trlist(traders)
@@ -74,6 +80,8 @@ WebCfg::WebCfg( const shared_lockable_ptr<State> &state,
 	,backtest_broker(backtest_broker)
 	,upload_limit(upload_limit)
     ,share_limit(share_limit)
+	,tick_import_path(std::move(tick_import_path))
+	,sweeps(std::make_shared<SweepControl>(std::max(1U, std::thread::hardware_concurrency())))
 {
 
 }
@@ -676,9 +684,60 @@ bool WebCfg::reqTraders(simpleServer::HTTPRequest req, ondra_shared::StrViewA vp
 						Value(Object({{"entries",{"stop","info","clear_stats","reset","broker","trading","strategy","trade_now"}}})).stringify().str());
 				}
 			} else {
+				auto cmd = urlDecode(StrViewA(splt()));
+				if (cmd == "info" || cmd == "trading") {
+					//read only commands are served from the snapshot, they don't wait for the cycle
+					MTrader::PSnapshot snapshot = trlist.lock_shared()->getSnapshot(trid);
+					if (snapshot == nullptr || !snapshot->loaded) {
+						tr.lock()->init();
+						snapshot = trlist.lock_shared()->getSnapshot(trid);
+					}
+					if (snapshot == nullptr) {
+						req.sendErrorPage(404);
+					} else if (cmd == "info") {
+						json::Value j = snapshot->minfo.toJSON();
+						j = j.replace("pair", snapshot->pairsymb);
+						req.sendResponse(std::move(hdr), j.stringify().str());
+					} else {
+						Object out;
+						const auto &chart = snapshot->chart;
+						auto chart_beg = chart.size()>600?chart.end()-600:chart.begin();
+						PStockApi broker = snapshot->broker;
+						broker->reset(std::chrono::system_clock::now());
+						out.set("chart", Value(json::array,chart_beg, chart.end(),[&](auto &&item) {
+							return Object({{"time", item.time},{"last",item.last}});
+						}));
+						std::size_t start = chart_beg == chart.end()?0:chart_beg->time;
+						const auto &trades = *snapshot->trades;
+						out.set("trades", Value(json::array, trades.begin(), trades.end(),[&](auto &&item) {
+							if (item.time >= start) return item.toJSON(); else return Value();
+						}));
+						auto ticker = broker->getTicker(snapshot->pairsymb);
+						double stprice = strtod(splt().data,0);
+						out.set("ticker", Object({{"ask", ticker.ask},{"bid", ticker.bid},{"last", ticker.last},{"time", ticker.time}}));
+						out.set("orders", getOpenOrders(broker, snapshot->pairsymb));
+						out.set("broker", snapshot->broker_name);
+						out.set("pair", getPairInfo(broker, snapshot->pairsymb));
+						Strategy strategy = snapshot->strategy;
+						double assets = snapshot->strategy_position;
+						double currencies = *snapshot->currency;
+						auto eq = strategy.getEquilibrium(assets);
+						auto minfo = snapshot->minfo;
+						if (stprice) {
+							if (minfo.invert_price) stprice = 1.0/stprice;
+						}else {
+							stprice = ticker.last;
+						}
+						auto order = strategy.getNewOrder(minfo,ticker.last, stprice, sgn(eq - stprice),assets, currencies, false);
+						order.price = stprice;
+						minfo.addFees(order.size, order.price);
+						out.set("strategy",Object({{"size", (minfo.invert_price?-1:1)*order.size}}));
+						req.sendResponse(std::move(hdr), Value(out).stringify().str());
+					}
+					return true;
+				}
 				auto trl = tr.lock();
 				trl->init();
-				auto cmd = urlDecode(StrViewA(splt()));
 				if (cmd == "clear_stats") {
 					if (!req.allowMethods({"POST"})) return true;
 					Stream s = req.getBodyStream();
@@ -738,47 +797,6 @@ bool WebCfg::reqTraders(simpleServer::HTTPRequest req, ondra_shared::StrViewA vp
 					StrViewA restpath = vpath.substr(nx.data - vpath.data);
 					std::string brokerName = trl->getConfig().broker;
 					reqBrokerSpec(req, restpath, (trl->getBroker()), brokerName);
-				} else if (cmd == "info") {
-				    auto minfo = trl->getMarketInfo();
-				    json::Value j = minfo.toJSON();
-				    j = j.replace("pair", trl->getConfig().pairsymb);
-                    req.sendResponse(std::move(hdr), j.stringify().str());
-				} else if (cmd == "trading") {
-					Object out;
-					auto chartx = trl->getChart();
-					ondra_shared::StringView<MTrader::ChartItem> chart(chartx.data(), chartx.size());
-					PStockApi broker = trl->getBroker();
-					broker->reset(std::chrono::system_clock::now());
-					if (chart.length>600) chart = chart.substr(chart.length-600);
-					out.set("chart", Value(json::array,chart.begin(), chart.end(),[&](auto &&item) {
-						return Object({{"time", item.time},{"last",item.last}});
-					}));
-					std::size_t start = chart.empty()?0:chart[0].time;
-					auto trades = trl->getTrades();
-					out.set("trades", Value(json::array, trades.begin(), trades.end(),[&](auto &&item) {
-						if (item.time >= start) return item.toJSON(); else return Value();
-					}));
-					auto ticker = broker->getTicker(trl->getConfig().pairsymb);
-					double stprice = strtod(splt().data,0);
-					out.set("ticker", Object({{"ask", ticker.ask},{"bid", ticker.bid},{"last", ticker.last},{"time", ticker.time}}));
-					out.set("orders", getOpenOrders(broker, trl->getConfig().pairsymb));
-					out.set("broker", trl->getConfig().broker);
-					out.set("pair", getPairInfo(broker, trl->getConfig().pairsymb));
-                    auto strategy = trl->getStrategy();
-                    double assets = trl->getStrategyPosition();
-                    double currencies = *trl->getCurrency();
-                    auto eq = strategy.getEquilibrium(assets);
-                    auto minfo = trl->getMarketInfo();
-                    if (stprice) {
-                        if (minfo.invert_price) stprice = 1.0/stprice;
-                    }else {
-                        stprice = ticker.last;
-                    }
-                    auto order = strategy.getNewOrder(minfo,ticker.last, stprice, sgn(eq - stprice),assets, currencies, false);
-                    order.price = stprice;
-                    minfo.addFees(order.size, order.price);
-                    out.set("strategy",Object({{"size", (minfo.invert_price?-1:1)*order.size}}));
-					req.sendResponse(std::move(hdr), Value(out).stringify().str());
 				} else if (cmd == "strategy") {
 					if (!req.allowMethods({"GET","PUT"})) return true;
 					Strategy strategy = trl->getStrategy();
@@ -1089,20 +1107,19 @@ bool WebCfg::reqEditor(simpleServer::HTTPRequest req)  {
 				Value costs;
 				Value rpnl;
 				Value visstrategy;
-				if (tr) {
-	                auto trl = tr.lock();
+				MTrader::PSnapshot snapshot = tr?trlist.lock_shared()->getSnapshot(trader.toString().str()):nullptr;
+				if (snapshot) {
 					try {
-						Strategy stratobj=trl->getStrategy();
-						strategy = stratobj.dumpStatePretty(trl->getMarketInfo());
-						auto trades = trl->getTrades();
-						auto assBal = trl->getPosition();
-						position =assBal;
-						partialPos = trl->getPartialPosition();
+						Strategy stratobj=snapshot->strategy;
+						strategy = stratobj.dumpStatePretty(snapshot->minfo);
+						const auto &trades = *snapshot->trades;
+						position = snapshot->position;
+						partialPos = snapshot->partial_position;
 						tradeCnt = trades.size();
-						enter_price = trl->getEnterPrice();
-						costs = trl->getCosts();
-						enter_price_pos = trl->getEnterPricePos();
-						rpnl = trl->getRPnL();
+						enter_price = snapshot->enter_price;
+						costs = snapshot->costs;
+						enter_price_pos = snapshot->enter_price_pos;
+						rpnl = snapshot->rpnl;
 						double price = trades.empty()?pair["price"].getNumber():trades.back().price;
 						double pos = position.getNumber();
 						double cur = stratobj.calcCurrencyAllocation(price, minfo.leverage>0);
@@ -1118,11 +1135,18 @@ bool WebCfg::reqEditor(simpleServer::HTTPRequest req)  {
 						};
 						std::vector<Pt> points;
 						double prev_y = 0;
+						std::vector<double> grid, grid2;
 						for (int i = 0; i < 200; i++) {
 							double x = beg+(end-beg)*(i/200.0);
-							IStrategy::ChartPoint pt = stratobj.calcChart(x);
-							IStrategy::ChartPoint pt2 = stratobj.calcChart(x*1.02);
-							//if (!pt2.valid) pt2 = stratobj.calcChart(x*0.98);
+							grid.push_back(x);
+							grid2.push_back(x*1.02);
+						}
+						auto chart = stratobj.calcChartBatch(grid);
+						auto chart2 = stratobj.calcChartBatch(grid2);
+						for (int i = 0; i < 200; i++) {
+							double x = grid[i];
+							const IStrategy::ChartPoint &pt = chart[i];
+							const IStrategy::ChartPoint &pt2 = chart2[i];
 							if (pt.valid && std::isfinite(pt.budget) && std::isfinite(pt.position)) {
 								double y = pt2.valid?pt.position*x*0.02+pt.budget-pt2.budget:0;
 								if (y < 0) y = prev_y;
@@ -1197,7 +1221,7 @@ bool WebCfg::reqEditor(simpleServer::HTTPRequest req)  {
 				result.set("enter_price_pos", enter_price_pos);
 				result.set("rpnl", rpnl);
 				result.set("costs", costs);
-				result.set("accumulation", tr == nullptr?0.0:tr.lock()->getAccumulated());
+				result.set("accumulation", snapshot == nullptr?0.0:snapshot->accumulated);
 				result.set("trades", tradeCnt);
 				result.set("exists", exists);
 				result.set("need_initial_reset",need_initial_reset);
@@ -1364,23 +1388,21 @@ bool WebCfg::reqBacktest(simpleServer::HTTPRequest req, ondra_shared::StrViewA r
 				} else {
 					lkst.release();
 						try {
-							auto tr = trlist.lock_shared()->find(id.getString());
-							if (tr == nullptr) {
+							auto snapshot = trlist.lock_shared()->getSnapshot(id.getString());
+							if (snapshot == nullptr) {
 								req.sendErrorPage(404);
 								return;
 							}
-							auto trl = tr.lock_shared();
 
-							const auto &tradeHist = trl->getTrades();
+							const auto &tradeHist = *snapshot->trades;
 							BacktestCacheSubj trs;
 							std::transform(tradeHist.begin(),tradeHist.end(),
 									std::back_insert_iterator(trs.prices),[](const IStatSvc::TradeRecord &r) {
 								return BTPrice{r.time, r.price};
 							});
-							trs.minfo = trl->getMarketInfo();
+							trs.minfo = snapshot->minfo;
 							trs.inverted = false;
 							trs.reversed = false;
-							trl.release();
 
 							state.lock()->backtest_cache = BacktestCache(trs, id.toString().str());
 							process(*trlist.lock(), trs, invert.getBool(), reverse.getBool());
@@ -1484,16 +1506,14 @@ bool WebCfg::reqSpread(simpleServer::HTTPRequest req)  {
 			} else {
 				lkst.release();
 				try {
-					auto tr = trlist.lock_shared()->find(id.getString());
-					if (tr == nullptr) {
+					auto snapshot = trlist.lock_shared()->getSnapshot(id.getString());
+					if (snapshot == nullptr) {
 						req.sendErrorPage(404);
 						return;
 					}
-					auto trl = tr.lock_shared();
 					SpreadCacheItem x;
-					x.chart = trl->getChart();
-					x.invert_price = trl->getMarketInfo().invert_price;
-					trl.release();
+					x.chart = snapshot->chart;
+					x.invert_price = snapshot->minfo.invert_price;
 					state.lock()->spread_cache= SpreadCache(x, id.toString().str());
 					process(x);
 				} catch (std::exception &e) {
@@ -1532,10 +1552,10 @@ bool WebCfg::reqStrategy(simpleServer::HTTPRequest req) {
 
 
 	if (!trader.empty()) {
-		auto tr = this->trlist.lock_shared()->find(trader);
-		if (tr != nullptr) {
-			Strategy trs = tr.lock_shared()->getStrategy();
-			minfo = tr.lock_shared()->getMarketInfo();
+		auto snapshot = this->trlist.lock_shared()->getSnapshot(trader);
+		if (snapshot != nullptr) {
+			Strategy trs = snapshot->strategy;
+			minfo = snapshot->minfo;
 			if (trs.getID() == s.getID()) {
 				s.importState(trs.exportState(),minfo);
 			}
@@ -1658,23 +1678,17 @@ bool WebCfg::reqVisStrategy(simpleServer::HTTPRequest req,  simpleServer::QueryP
 	double bal_a = std::strtod(assets.data,nullptr);
 	double bal_c = std::strtod(currency.data,nullptr);
 	double price = std::strtod(sprice.data,nullptr);
-	auto trader = trlist.lock_shared()->find(id);
+	auto snapshot = trlist.lock_shared()->getSnapshot(id);
 	std::ostringstream tmp;
-	if (trader == nullptr) {
+	if (snapshot == nullptr) {
 		req.sendErrorPage(404);
 	} else {
-		Strategy st(nullptr);
-		IStockApi::MarketInfo minfo;
-		IStrategy::MinMax range;
 		std::vector<double> pt_budget, pt_value;
-		{
-			auto tr = trader.lock_shared();
-			auto trades = tr->getTrades();
-			if (!trades.empty()) price = trades.back().price;
-			st = tr->getStrategy();
-			minfo = tr->getMarketInfo();
-			range = st.calcSafeRange(minfo, bal_a, bal_c);
-		}
+		const auto &trades = *snapshot->trades;
+		if (!trades.empty()) price = trades.back().price;
+		Strategy st = snapshot->strategy;
+		const IStockApi::MarketInfo &minfo = snapshot->minfo;
+		IStrategy::MinMax range = st.calcSafeRange(minfo, bal_a, bal_c);
 
 		Stream out = req.sendResponse(simpleServer::HTTPResponse(200)
 					.contentType("image/svg+xml").cacheFor(600));
@@ -1710,9 +1724,12 @@ bool WebCfg::reqVisStrategy(simpleServer::HTTPRequest req,  simpleServer::QueryP
 			};
 
 
+			std::vector<double> grid;
+			for (unsigned int i = 0; i <= 400; i++) grid.push_back(imap_price(i*2));
+			auto chart = st.calcChartBatch(grid);
 			for (unsigned int i = 0; i <= 400; i++) {
-				double p = imap_price(i*2);
-				auto pt = st.calcChart(p);
+				double p = grid[i];
+				const auto &pt = chart[i];
 				if (!pt.valid) {
 					continue;
 				}
@@ -1842,7 +1859,11 @@ enum class BTAction {
 	historical_chart,
 	gen_trades,
 	run,
-	probe
+	probe,
+	sweep,
+	portfolio,
+	upload_ticks,
+	import_ticks
 };
 
 
@@ -1856,8 +1877,184 @@ static NamedEnum<BTAction> strBTAction({
 	{BTAction::gen_trades, "gen_trades"},
 	{BTAction::run, "run"},
 	{BTAction::probe, "probe"},
+	{BTAction::sweep, "sweep"},
+	{BTAction::portfolio, "portfolio"},
+	{BTAction::upload_ticks, "upload_ticks"},
+	{BTAction::import_ticks, "import_ticks"},
 });
 
+///Creates price source over columnar price series
+/**
+ * Prices are read directly from the columns, all transformations are applied on the fly.
+ * Price series are expected ordered by time
+ *
+ * @param cols columnar price series
+ * @param start_date skip prices before this date
+ * @param rev reverse prices (time is not reversed)
+ * @param inv invert chart around the average price
+ * @param ip initial price (0 to keep original prices)
+ * @param invert_price market inverts price
+ * @return price source
+ */
+static BTPriceSource columnPriceSource(const PBTColumns &cols, std::uint64_t start_date, bool rev, bool inv, double ip, bool invert_price) {
+	const std::uint64_t *t = cols->time();
+	const double *p = cols->price();
+	const double *pmin = cols->pmin();
+	const double *pmax = cols->pmax();
+	std::size_t cnt = cols->size();
+	std::size_t beg = std::lower_bound(t, t+cnt, start_date) - t;
+
+	double mlt = 1.0;
+	double fv = beg == cnt?ip:p[rev?cnt-1:beg];
+	if (ip && beg != cnt) {
+		double avg = std::accumulate(p+beg, p+cnt, 0.0)/(cnt-beg);
+		if (inv) fv = 2*avg - fv;
+		mlt = ip/fv;
+		fv = fv * mlt;
+	}
+	double fv2 = pow2(fv);
+
+	//source keeps columns alive (mapped data)
+	return [=, cols = cols, pos = beg]() mutable {
+		if (pos >= cnt) return std::optional<BTPrice>();
+		BTPrice x {t[pos], p[rev?cnt-1-(pos-beg):pos]*mlt, pmin[pos]*mlt, pmax[pos]*mlt};
+		++pos;
+		if (inv) {
+			x.price = fv2/x.price;
+			double tmp = fv2/x.pmin;
+			x.pmin = fv2/x.pmax;
+			x.pmax = tmp;
+		}
+		if (invert_price) {
+			x.price = 1.0/x.price;
+			double tmp = 1.0/x.pmin;
+			x.pmin = 1.0/x.pmax;
+			x.pmax = tmp;
+		}
+		return std::optional<BTPrice>(x);
+	};
+}
+
+static Value btEventToJSON(BTEvent ev) {
+	switch (ev) {
+	default: return btevent_no_event;
+	case BTEvent::accept_loss: return btevent_accept_loss;
+	case BTEvent::liquidation: return btevent_liquidation;
+	case BTEvent::margin_call: return btevent_margin_call;
+	case BTEvent::no_balance: return btevent_no_balance;
+	case BTEvent::error: return btevent_error;
+	}
+}
+
+///Format of the result of backtest run
+/**
+ * json - array of objects (one object per trade)
+ * compact - array of arrays, first array contains names of the columns
+ * binary - rows of 15 little-endian doubles: tm, pr, sz, ps, pl, npl, npla, na, np, op, rpnl, upnl, bal, ubal, event.
+ *          Event is index of BTEvent, info is not included
+ */
+enum class BTRunFormat {
+	json,
+	compact,
+	binary
+};
+
+static NamedEnum<BTRunFormat> strBTRunFormat({
+	{BTRunFormat::json, "json"},
+	{BTRunFormat::compact, "compact"},
+	{BTRunFormat::binary, "binary"}
+});
+
+///Creates summary of backtest result (probe)
+static Value probeSummary(const BTTrades &rs, double balance, double init_pos, const IStockApi::MarketInfo &minfo) {
+	std::size_t accept_loss = 0, liquidation=0,margin_call=0,no_balance=0,error=0,alerts=0;
+	for (const auto &item: rs) {
+		switch (item.event) {
+			case BTEvent::accept_loss: ++accept_loss;break;
+			case BTEvent::liquidation: ++liquidation;break;
+			case BTEvent::margin_call: ++margin_call;break;
+			case BTEvent::no_balance: ++no_balance;break;
+			case BTEvent::error: ++error;break;
+			default:break;
+		}
+		if (item.size == 0) ++alerts;
+	}
+
+	double bal = 1;
+	double pl = 0;
+	double npl = 0;
+	double na = 0;
+
+	if (!rs.empty()) {
+		bal = balance;
+		if (minfo.leverage==0) {
+			bal += init_pos*rs[0].price;
+		}
+		pl = rs.back().pl;
+		npl = rs.back().norm_profit;
+		na = rs.back().norm_accum;
+	}
+
+	return json::Object {
+		{"events",json::Object {
+			{"accept_loss",accept_loss},
+			{"liquidation",liquidation},
+			{"margin_call",margin_call},
+			{"no_balance",no_balance},
+			{"error",error},
+			{"alerts",alerts},
+		}},
+		{"pl",pl},
+		{"npl",npl},
+		{"na",na},
+		{"pc_pl",pl/bal*100.0},
+		{"pc_npl",npl/bal*100.0}
+	};
+}
+
+///Sets value to the config, path can refer nested object (strategy.exponent)
+static Value applySweepOverride(Value cfg, StrViewA path, Value v) {
+	auto pos = path.indexOf(".");
+	if (pos == path.npos) return cfg.replace(path, v);
+	StrViewA k = path.substr(0, pos);
+	Value sub = cfg[k];
+	if (sub.type() != json::object) sub = json::object;
+	return cfg.replace(k, applySweepOverride(sub, path.substr(pos+1), v));
+}
+
+///Expands sweep definition to a list of overrides
+/**
+ * @param sweep either array of objects (list of overrides), or object, where every
+ * key contains array of values (grid). The grid is expanded to all combinations
+ * @param limit maximum count of combinations
+ * @return list of overrides, empty if invalid or too large
+ */
+static std::vector<Value> expandSweep(Value sweep, std::size_t limit) {
+	std::vector<Value> out;
+	if (sweep.type() == json::array) {
+		if (sweep.size() > limit) return out;
+		for (Value x: sweep) {
+			if (x.type() != json::object) return {};
+			out.push_back(x);
+		}
+	} else if (sweep.type() == json::object) {
+		out.push_back(json::object);
+		for (Value k: sweep) {
+			if (k.type() != json::array || k.empty()) return {};
+			if (out.size() * k.size() > limit) return {};
+			std::vector<Value> nx;
+			nx.reserve(out.size() * k.size());
+			for (Value o: out) {
+				for (Value v: k) nx.push_back(o.replace(k.getKey(), v));
+			}
+			std::swap(out, nx);
+		}
+	}
+	return out;
+}
+
+static const std::size_t max_sweep_combinations = 10000;
+
 bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrViewA rest) {
 	if (!req.allowMethods({"POST","GET"})) return true;
 	if (req.getMethod() == "GET") {
@@ -1882,7 +2079,21 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 		req.readBodyAsync(upload_limit,[action,
 										trlist = this->trlist,
 										state =  this->state,
-										prices = this->backtest_broker](simpleServer::HTTPRequest req) mutable{
+										prices = this->backtest_broker,
+										sweeps = this->sweeps,
+										tick_import_path = this->tick_import_path](simpleServer::HTTPRequest req) mutable{
+			if (action == BTAction::upload_ticks) {
+				//body is binary - see BTColumns::create_ticks
+				auto buff = req.getUserBuffer();
+				PBTColumns ticks = BTColumns::create_ticks(buff.data(), buff.size());
+				if (ticks == nullptr) {
+					req.sendErrorPage(400,"Invalid tick data");return;
+				}
+				std::string id = state.lock()->backtest_storage.lock()->store_data(ticks);
+				auto stream = req.sendResponse("application/json");
+				Value(json::object, {Value("id",id), Value("ticks", ticks->size())}).serialize(stream);
+				return;
+			}
 			Value args = Value::fromString(json::map_bin2str(req.getUserBuffer()));
 			auto storage = state.lock()->backtest_storage;
 			Value response;
@@ -1892,30 +2103,47 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 					std::string id = storage.lock()->store_data(args);
 					response=Value(json::object, {Value("id",id)});
 				}break;
+				case BTAction::import_ticks: {
+					//file is converted on the server, so size of the data is not limited by upload_limit
+					if (tick_import_path.empty()) {
+						req.sendErrorPage(403,"","Import of tick data is not enabled (backtest/tick_import_path)");return;
+					}
+					std::string_view fname = args["file"].getString();
+					if (fname.empty() || fname == "." || fname == ".." || fname.find('/') != fname.npos) {
+						req.sendErrorPage(400,"","Invalid file name");return;
+					}
+					PBTColumns ticks = BacktestStorage::import_ticks(tick_import_path+"/"+std::string(fname));
+					if (ticks == nullptr) {
+						req.sendErrorPage(400,"","File not found or invalid tick data");return;
+					}
+					std::string id = storage.lock()->store_data(ticks);
+					response=Value(json::object, {Value("id",id), Value("ticks", ticks->size())});
+				}break;
 				case BTAction::trader_minute_chart: {
 					Value trader = args["trader"];
-					auto tr  =trlist.lock()->find(trader.getString());
-					if (tr == nullptr) {req.sendErrorPage(404);return;}
-					auto chart = tr.lock_shared()->getChart();
-					Value chart_data (json::array, chart.begin(), chart.end(), [](const MTrader::ChartItem &itm)->Value{
-						return itm.last;
-					});
-					std::string id = storage.lock()->store_data(chart_data);
+					auto snapshot = trlist.lock_shared()->getSnapshot(trader.getString());
+					if (snapshot == nullptr) {req.sendErrorPage(404);return;}
+					const auto &chart = snapshot->chart;
+					std::vector<double> chart_data;
+					chart_data.reserve(chart.size());
+					for (const MTrader::ChartItem &itm: chart) chart_data.push_back(itm.last);
+					std::string id = storage.lock()->store_data(BTColumns::create(chart_data));
 					response=Value(json::object, {Value("id",id)});
 				}break;
 				case BTAction::trader_chart: {
 					Value trader = args["trader"];
-					auto tr  =trlist.lock()->find(trader.getString());
-					if (tr == nullptr) {req.sendErrorPage(404);return;}
-					auto trl = tr.lock_shared();
-					auto trd = trl->getTrades();
-					auto nfo = trl->getMarketInfo();
-					Value chart_data (json::array, trd.begin(), trd.end(), [&](const IStatSvc::TradeRecord &itm)->Value{
-						if (itm.partial_exec) return json::Value();
-					    if (nfo.invert_price) return {itm.time, 1.0/itm.price};
-						else return {itm.time, itm.price};
-					});
-					std::string id = storage.lock()->store_data(chart_data);
+					auto snapshot = trlist.lock_shared()->getSnapshot(trader.getString());
+					if (snapshot == nullptr) {req.sendErrorPage(404);return;}
+					const auto &trd = *snapshot->trades;
+					const auto &nfo = snapshot->minfo;
+					std::vector<BTPrice> chart_data;
+					chart_data.reserve(trd.size());
+					for (const IStatSvc::TradeRecord &itm: trd) {
+						if (itm.partial_exec) continue;
+						double p = nfo.invert_price?1.0/itm.price:itm.price;
+						chart_data.push_back({itm.time, p, p, p});
+					}
+					std::string id = storage.lock()->store_data(BTColumns::create(chart_data));
 					response=Value(json::object, {Value("id",id)});
 				}break;
 				case BTAction::historical_chart: {
@@ -1928,17 +2156,26 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 					);
 					from = (from/86400)*86400;
 					auto btb = prices.lock();
-					Value chart_data = btb->jsonRequestExchange("minute", Object({{"asset", asset},{"currency",currency},{"from",from}}));
-					if (smooth>1) {
-						double accum = chart_data[0].getNumber()*smooth;
-						Value smth_data (json::array,chart_data.begin(), chart_data.end(),[&](const Value &d){
+					auto fetch = [&](std::uint64_t tm) {
+						Value jchart = btb->jsonRequestExchange("minute", Object({{"asset", asset},{"currency",currency},{"from",tm/1000},{"packed",true}}));
+						std::vector<double> chart_data;
+						unpackNumbers(jchart, chart_data);
+						return chart_data;
+					};
+					auto cache = MinuteHistoryCache::getInstance();
+					std::uint64_t from_ms = static_cast<std::uint64_t>(from)*1000;
+					std::vector<double> chart_data = cache != nullptr
+							?cache->read("history_broker", std::string(asset.getString()), std::string(currency.getString()), from_ms, fetch)
+							:fetch(from_ms);
+					if (smooth>1 && !chart_data.empty()) {
+						double accum = chart_data[0]*smooth;
+						for (double &d: chart_data) {
 							accum -= accum / smooth;
-							accum += d.getNumber();
-							return accum/smooth;
-						});
-						chart_data = smth_data;
+							accum += d;
+							d = accum/smooth;
+						}
 					}
-					std::string id = storage.lock()->store_data(chart_data);
+					std::string id = storage.lock()->store_data(BTColumns::create(chart_data));
 					response=Value(json::object, {Value("id",id)});
 				}break;
 				case BTAction::random_chart: {
@@ -1948,8 +2185,7 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 					double noise = args["noise"].getValueOrDefault(0.0);
 					std::vector<double> chart;
 					generate_random_chart(volatility*0.01, noise*0.01, 525600, seed, chart);
-					Value chart_data (json::array, chart.begin(), chart.end(), [](double &itm)->Value{return itm;});
-					std::string id = storage.lock()->store_data(chart_data);
+					std::string id = storage.lock()->store_data(BTColumns::create(chart));
 					response=Value(json::object, {Value("id",id)});
 				}break;
 				case BTAction::get_file: {
@@ -1972,33 +2208,63 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 					Value limit = args["limit"];
 					Value begin_time = args["begin_time"];
 					auto swap = args["swap"].getBool();
+					auto warmup = args["warmup"].getBool();
 
 					auto state = fn->start();
 
-					Value srcminute = storage.lock()->load_data(source.getString());
-					if (!srcminute.defined()) {
+					PBTColumns srccols = storage.lock()->load_columns(source.getString());
+					if (srccols == nullptr) {
 						req.sendErrorPage(410);
 						return;
 					}
 
-					if (reverse.getBool()) {
-						srcminute = srcminute.reverse();
-					}
+					const double *srcminute = srccols->price();
+					std::size_t srcsize = srccols->size();
+					bool rev = reverse.getBool();
 					bool inv = invert.getBool();
 					bool ifut = ifutures.getBool();
+					if (srccols->type() == BTColumns::ticks) {
+						if (rev || inv) {
+							req.sendErrorPage(400,"Tick data can't be reversed or inverted");return;
+						}
+						std::vector<BTPrice> out;
+						BTPriceSource src = tickTradeSource(srccols, fn, begin_time.getUIntLong(), swap, ifut, false, warmup);
+						for (auto x = src(); x.has_value(); x = src()) out.push_back(*x);
+						std::string id = storage.lock()->store_data(BTColumns::create(out));
+						response=Value(json::object, {
+								Value("id",id),
+								Value("samples",srcsize),
+								Value("trades",out.size())
+						});
+						break;
+					}
 					double init = 0;
 					std::vector<BTPrice> out;
-					out.reserve(srcminute.size());
-					std::uint64_t t = !begin_time.defined()?std::chrono::duration_cast<std::chrono::milliseconds>((std::chrono::system_clock::now() - std::chrono::minutes(srcminute.size())).time_since_epoch()).count()
+					out.reserve(srcsize);
+					std::uint64_t t = !begin_time.defined()?std::chrono::duration_cast<std::chrono::milliseconds>((std::chrono::system_clock::now() - std::chrono::minutes(srcsize)).time_since_epoch()).count()
 								:begin_time.getUIntLong();
 					BTPrice tmp;
 					BTPrice *last = nullptr;
 					std::size_t ofs = offset.getUInt();
-					std::size_t lim = std::min<std::size_t>(limit.defined()?limit.getUInt()+ofs:static_cast<std::size_t>(-1),srcminute.size());
-					for (std::size_t pos = ofs; pos < lim;++pos) {
-						const auto &itm =  srcminute[pos];
-						double w = itm.getNumber();
+					std::size_t lim = std::min<std::size_t>(limit.defined()?limit.getUInt()+ofs:static_cast<std::size_t>(-1),srcsize);
+					auto srcprice = [&](std::size_t pos) {
+						double w = srcminute[rev?srcsize-1-pos:pos];
 						if (swap) w = 1.0/w;
+						return w;
+					};
+					if (warmup && ofs < lim) {
+						//minutes skipped by the offset initialize the spread generator
+						//inverted chart is scaled by the first generated minute, same as without warmup
+						if (inv) init = pow2(srcprice(ofs));
+						std::size_t hist = std::min<std::size_t>(fn->get_required_history_length(), ofs);
+						for (std::size_t pos = ofs - hist; pos < ofs; ++pos) {
+							double w = srcprice(pos);
+							if (inv) w = init/w;
+							fn->point(state, ifut?1.0/w:w, false);
+						}
+					}
+					for (std::size_t pos = ofs; pos < lim;++pos) {
+						double w = srcprice(pos);
 						if (inv) {
 							if (init == 0) init = pow2(w);
 							w = init/w;
@@ -2036,14 +2302,11 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 
 						t+=60000;
 					}
-					Value chart_data(json::array, out.begin(), out.end(), [](const BTPrice &bt)->json::Value{
-						return {bt.time, bt.price, {bt.pmin, bt.pmax}};
-					});
-					std::string id = storage.lock()->store_data(chart_data);
+					std::string id = storage.lock()->store_data(BTColumns::create(out));
 					response=Value(json::object, {
 							Value("id",id),
-							Value("samples",srcminute.size()),
-							Value("trades",chart_data.size())
+							Value("samples",srcsize),
+							Value("trades",out.size())
 					});
 				}break;
 				case BTAction::probe:
@@ -2078,86 +2341,44 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 					std::optional<double> m_init_pos;
 					if (init_pos.hasValue()) m_init_pos = init_pos.getNumber();
 
-					Value jtrades = storage.lock()->load_data(source.getString());
-					if (!jtrades.defined()) {
+					PBTColumns trades = storage.lock()->load_columns(source.getString());
+					if (trades == nullptr) {
 						req.sendErrorPage(410);
 						return;
 					}
-
-
-					std::vector<BTPrice> trades;
-					trades.reserve(jtrades.size());
-
-
-					for (Value x: jtrades) {
-						std::uint64_t tm = x[0].getUIntLong();
-						if (tm >= start_date) {
-							Value r = x[2];
-							bool hasr = r.type() == json::array;
-							double p = x[1].getNumber();
-							double pmin = hasr?x[2][0].getNumber():p;
-							double pmax = hasr?x[2][1].getNumber():p;
-							trades.push_back({tm, p, pmin,pmax});
-						}
-					}
-
-					if (rev) {
-						for (std::size_t i = 0, cnt = trades.size(); i<cnt/2; i++) {
-							std::swap(trades[i].price, trades[cnt-i-1].price);
-						}
-					}
-
-					double mlt = 1.0;
-					double avg = std::accumulate(trades.begin(), trades.end(),0.0,[](double a, const BTPrice &b){
-						return a + b.price;
-					})/trades.size();
-
-					double ip = init_price.getNumber();
-					double fv = trades.empty()?ip:trades[0].price;
-					if (ip && !trades.empty()) {
-						if (inv) fv = 2*avg - fv;
-						mlt = ip/fv;
-						fv = fv * mlt;
-					}
-
-					for (auto &x: trades) {
-						x.price *= mlt;
-						x.pmin *= mlt;
-						x.pmax *= mlt;
-					}
-
-					if (inv) {
-						for (auto &x: trades) {
-							x.price = pow2(fv)/x.price;
-							double tmp = pow2(fv)/x.pmin;
-							x.pmin = pow2(fv)/x.pmax;
-							x.pmax = tmp;
-						}
-					}
-					if (minfo.invert_price) {
-						for (auto &x: trades) {
-							x.price = 1.0/x.price;
-							double tmp = 1.0/x.pmin;
-							x.pmin = 1.0/x.pmax;
-							x.pmax = tmp;
+					BTPriceSource priceSource;
+					if (trades->type() == BTColumns::ticks) {
+						//executions are generated from ticks by the spread generator
+						Value spread = args["spread"];
+						if (!spread.defined()) {
+							req.sendErrorPage(400,"Tick source requires spread");return;
 						}
+						priceSource = tickTradeSource(trades, initializeSpreadGenerator(spread), start_date, false, false, minfo.invert_price, args["warmup"].getBool());
+					} else if (trades->type() != BTColumns::prices) {
+						req.sendErrorPage(400,"Source is not a price series");return;
+					} else {
+						priceSource = columnPriceSource(trades, start_date, rev, inv, init_price.getNumber(), minfo.invert_price);
 					}
 
-
-
-
-					BTTrades rs = backtest_cycle(mconfig,
-							[iter = trades.begin(), end = trades.end()]() mutable {
-						if (iter == end) return std::optional<BTPrice>();
-						else return std::optional<BTPrice>(*iter++);
-					},minfo,m_init_pos, balance.getNumber(), negbal.getBool(), spend.getBool());
-
 					if (action == BTAction::run) {
-
+						//rows are streamed as they are produced by the backtest
+						BTRunFormat fmt = strBTRunFormat[args["format"].getValueOrDefault(std::string_view("json"))];
+						std::optional<Stream> stream;
+						std::size_t rows = 0;
+						auto openStream = [&]{
+							stream.emplace(req.sendResponse(fmt == BTRunFormat::binary?"application/octet-stream":"application/json"));
+							if (fmt == BTRunFormat::compact) {
+								(*stream) << "[[\"tm\",\"pr\",\"sz\",\"ps\",\"pl\",\"npl\",\"npla\",\"na\",\"np\",\"op\",\"rpnl\",\"upnl\",\"bal\",\"ubal\",\"event\",\"info\"]";
+								++rows;
+							} else if (fmt == BTRunFormat::json) {
+								(*stream) << "[";
+							}
+						};
 						ACB acb(0,0);
 						double prev_open = 0;
-						Value result (json::array, rs.begin(), rs.end(), [&](const BTTrade &x) {
-							Value event;
+						backtest_cycle(mconfig, std::move(priceSource),
+							minfo,m_init_pos, balance.getNumber(), negbal.getBool(), spend.getBool(), [&](const BTTrade &x){
+							if (!stream.has_value()) openStream();
 							double open;
 							if (minfo.invert_price) {
 								acb = acb(1.0/x.price, -x.size);
@@ -2171,84 +2392,232 @@ bool WebCfg::reqBacktest_v2(simpleServer::HTTPRequest req, ondra_shared::StrView
 							} else {
 								prev_open = open;
 							}
-
-							switch (x.event) {
-							default: event = btevent_no_event;break;
-							case BTEvent::accept_loss: event = btevent_accept_loss;break;
-							case BTEvent::liquidation: event = btevent_liquidation;break;
-							case BTEvent::margin_call: event = btevent_margin_call;break;
-							case BTEvent::no_balance: event = btevent_no_balance;break;
-							case BTEvent::error: event = btevent_error;break;
+							try {
+								switch (fmt) {
+								default:
+								case BTRunFormat::json: {
+									if (rows) (*stream) << ",";
+									Value(Object({
+										{"np",x.neutral_price},
+										{"op",open},
+										{"rpnl",acb.getRPnL()},
+										{"upnl",acb.getUPnL(x.price)},
+										{"na",x.norm_accum},
+										{"npl",x.norm_profit},
+										{"npla",x.norm_profit_total},
+										{"pl",x.pl},
+										{"ps",x.pos},
+										{"pr",x.price},
+										{"tm",x.time},
+										{"bal",x.bal},
+										{"ubal",x.unspend_balance},
+										{"info",x.info},
+										{"sz",x.size},
+										{"event", btEventToJSON(x.event)}
+									})).serialize(*stream);
+								}break;
+								case BTRunFormat::compact: {
+									(*stream) << ",";
+									Value({x.time, x.price, x.size, x.pos, x.pl, x.norm_profit, x.norm_profit_total,
+										x.norm_accum, x.neutral_price, open, acb.getRPnL(), acb.getUPnL(x.price),
+										x.bal, x.unspend_balance, btEventToJSON(x.event), x.info}).serialize(*stream);
+								}break;
+								case BTRunFormat::binary: {
+									double row[] = {static_cast<double>(x.time), x.price, x.size, x.pos, x.pl, x.norm_profit, x.norm_profit_total,
+										x.norm_accum, x.neutral_price, open, acb.getRPnL(), acb.getUPnL(x.price),
+										x.bal, x.unspend_balance, static_cast<double>(x.event)};
+									stream->write(ondra_shared::BinaryView(reinterpret_cast<const unsigned char *>(row), sizeof(row)));
+								}break;
+								}
+								++rows;
+								//let the client process partial result
+								if ((rows & 0x3FF) == 0) stream->flush();
+								return true;
+							} catch (...) {
+								//connection lost, stop backtest
+								return false;
 							}
-							return Object({
-									{"np",x.neutral_price},
-									{"op",open},
-									{"rpnl",acb.getRPnL()},
-									{"upnl",acb.getUPnL(x.price)},
-									{"na",x.norm_accum},
-									{"npl",x.norm_profit},
-									{"npla",x.norm_profit_total},
-									{"pl",x.pl},
-									{"ps",x.pos},
-									{"pr",x.price},
-									{"tm",x.time},
-									{"bal",x.bal},
-									{"ubal",x.unspend_balance},
-									{"info",x.info},
-									{"sz",x.size},
-									{"event", event}
-							});
 						});
-
-						response = result;
+						if (!stream.has_value()) openStream();
+						if (fmt != BTRunFormat::binary) (*stream) << "]";
+						stream->flush();
+						return;
 					} else {
-						std::size_t accept_loss = 0, liquidation=0,margin_call=0,no_balance=0,error=0,alerts=0;
-						for (const auto &item: rs) {
-							switch (item.event) {
-								case BTEvent::accept_loss: ++accept_loss;break;
-								case BTEvent::liquidation: ++liquidation;break;
-								case BTEvent::margin_call: ++margin_call;break;
-								case BTEvent::no_balance: ++no_balance;break;
-								case BTEvent::error: ++error;break;
-								default:break;
-							}
-							if (item.size == 0) ++alerts;
-						}
+						BTTrades rs = backtest_cycle(mconfig, std::move(priceSource),
+								minfo,m_init_pos, balance.getNumber(), negbal.getBool(), spend.getBool());
+						response = probeSummary(rs, balance.getNumber(), init_pos.getNumber(), minfo);
+					}
 
-						double bal = 1;
-						double pl = 0;
-						double npl = 0;
-						double na = 0;
 
-						if (!rs.empty()) {
-							bal = balance.getNumber();
-							if (minfo.leverage==0) {
-								bal += init_pos.getNumber()*rs[0].price;
-							}
-							pl = rs.back().pl;
-							npl = rs.back().norm_profit;
-							na = rs.back().norm_accum;
-						}
 
-						response = json::Object {
-							{"events",json::Object {
-								{"accept_loss",accept_loss},
-								{"liquidation",liquidation},
-								{"margin_call",margin_call},
-								{"no_balance",no_balance},
-								{"error",error},
-								{"alerts",alerts},
-							}},
-							{"pl",pl},
-							{"npl",npl},
-							{"na",na},
-							{"pc_pl",pl/bal*100.0},
-							{"pc_npl",npl/bal*100.0}
-						};
+				}break;
+				case BTAction::sweep: {
+
+					Value minfo_val = args["minfo"];
+					Value source = args["source"];
+					Value config = args["config"];
+					Value init_pos = args["init_pos"];
+					bool rev = args["reverse"].getBool();
+					bool inv = args["invert"].getBool();
+					double balance = args["balance"].getNumber();
+					double init_price = args["init_price"].getNumber();
+					bool negbal= args["neg_bal"].getBool();
+					bool spend= args["spend"].getBool();
+					std::uint64_t start_date=args["start_date"].getUIntLong();
+
+					if (!minfo_val.defined()) {
+						req.sendErrorPage(400,"Missing minfo");return;
+					}
+					auto minfo = IStockApi::MarketInfo::fromJSON(minfo_val);
+					std::optional<double> m_init_pos;
+					if (init_pos.hasValue()) m_init_pos = init_pos.getNumber();
+
+					std::vector<Value> overrides = expandSweep(args["sweep"], max_sweep_combinations);
+					if (overrides.empty()) {
+						req.sendErrorPage(400,"Invalid or too large sweep");return;
 					}
 
+					PBTColumns trades = storage.lock()->load_columns(source.getString());
+					if (trades == nullptr) {
+						req.sendErrorPage(410);
+						return;
+					}
+					if (trades->type() != BTColumns::prices) {
+						req.sendErrorPage(400,"Source is not a price series");return;
+					}
 
+					if (++sweeps->active > max_concurrent_sweeps) {
+						--sweeps->active;
+						req.sendErrorPage(503,"Too many sweeps are running, try again later");return;
+					}
+					//state of the running sweep, shared by its tasks. The last finished
+					//task closes the response, so the http thread is not blocked
+					struct SweepTask {
+						std::shared_ptr<SweepControl> s;
+						HTTPRequest req;
+						Stream stream;
+						std::mutex lk;
+						bool first = true;
+						std::atomic<bool> lost = false;
+						std::atomic<std::size_t> remain;
+						SweepTask(std::shared_ptr<SweepControl> s, HTTPRequest req, Stream stream, std::size_t cnt)
+							:s(std::move(s)),req(std::move(req)),stream(std::move(stream)),remain(cnt) {}
+						~SweepTask() {--s->active;}
+						void finish() {
+							if (--remain) return;
+							try {
+								stream << "]";
+								stream.flush();
+							} catch (...) {
+								//connection lost
+							}
+						}
+					};
+
+					//results are streamed in order of completion, every result contains index of the combination
+					Stream stream = req.sendResponse("application/json");
+					stream << "[";
+					stream.flush();
+
+					ondra_shared::Worker wrk = sweeps->worker;
+					auto task = std::make_shared<SweepTask>(sweeps, req, stream, overrides.size());
+					for (std::size_t i = 0, n = overrides.size(); i < n; i++) {
+						wrk >> [=, ovr = overrides[i]] {
+							if (task->lost) {task->finish();return;}
+							Value res;
+							try {
+								Value cfg = config;
+								for (Value x: ovr) cfg = applySweepOverride(cfg, x.getKey(), x);
+								MTrader_Config mconfig;
+								mconfig.loadConfig(cfg);
+								BTTrades rs = backtest_cycle(mconfig,
+										columnPriceSource(trades, start_date, rev, inv, init_price, minfo.invert_price),
+										minfo, m_init_pos, balance, negbal, spend);
+								res = probeSummary(rs, balance, init_pos.getNumber(), minfo);
+							} catch (std::exception &e) {
+								res = Object{{"error", e.what()}};
+							}
+							res = res.replace("index", i).replace("config", ovr);
+							try {
+								std::lock_guard _(task->lk);
+								if (!task->first) task->stream << ",";
+								task->first = false;
+								res.serialize(task->stream);
+								task->stream.flush();
+							} catch (...) {
+								//connection lost, skip remaining combinations
+								task->lost = true;
+							}
+							task->finish();
+						};
+					}
+				}return;
+				case BTAction::portfolio: {
+					//traders sharing the same wallet, each trader has own price source
+					Value trlist_val = args["traders"];
+					Value balances_val = args["balances"];
+					bool negbal= args["neg_bal"].getBool();
+					if (trlist_val.type() != json::array || trlist_val.empty()) {
+						req.sendErrorPage(400,"Missing traders");return;
+					}
 
+					std::vector<BTPortfolioTrader> traders;
+					std::vector<double> init_pos;
+					for (Value t: trlist_val) {
+						Value minfo_val = t["minfo"];
+						Value source = t["source"];
+						if (!minfo_val.defined()) {
+							req.sendErrorPage(400,"Missing minfo");return;
+						}
+						PBTColumns cols = storage.lock()->load_columns(source.getString());
+						if (cols == nullptr) {
+							req.sendErrorPage(410);
+							return;
+						}
+						if (cols->type() != BTColumns::prices) {
+							req.sendErrorPage(400,"Source is not a price series");return;
+						}
+						BTPortfolioTrader pt;
+						pt.minfo = IStockApi::MarketInfo::fromJSON(minfo_val);
+						pt.config.loadConfig(t["config"]);
+						pt.source = columnPriceSource(cols, t["start_date"].getUIntLong(), t["reverse"].getBool(),
+								t["invert"].getBool(), t["init_price"].getNumber(), pt.minfo.invert_price);
+						if (t["init_pos"].hasValue()) pt.init_pos = t["init_pos"].getNumber();
+						pt.wallet = t["wallet"].toString().str();
+						init_pos.push_back(t["init_pos"].getNumber());
+						traders.push_back(std::move(pt));
+					}
+					BTWalletBalances balances;
+					for (Value b: balances_val) balances.emplace(std::string_view(b.getKey()), b.getNumber());
+
+					std::vector<IStockApi::MarketInfo> minfos;
+					for (const auto &t: traders) minfos.push_back(t.minfo);
+					BTPortfolioResult rs = backtest_portfolio(std::move(traders), balances, negbal);
+
+					std::vector<Value> trsum(rs.trades.size());
+					Array wsum;
+					for (const BTWalletResult &w: rs.wallets) {
+						auto b = balances.find(w.wallet);
+						double share = (b == balances.end()?0.0:b->second)/w.traders.size();
+						for (std::size_t idx: w.traders) {
+							trsum[idx] = probeSummary(rs.trades[idx], share, init_pos[idx], minfos[idx]).replace("wallet", w.wallet);
+						}
+						Array states;
+						for (const BTWalletState &st: w.states) {
+							states.push_back({st.time, st.balance, st.equity,
+								Value(json::array, st.allocation.begin(), st.allocation.end(), [](double x){return x;}),
+								btEventToJSON(st.event)});
+						}
+						wsum.push_back(Object{
+							{"wallet", w.wallet},
+							{"traders", Value(json::array, w.traders.begin(), w.traders.end(), [](std::size_t x){return x;})},
+							{"states", states}
+						});
+					}
+					response = Object{
+						{"traders", Value(json::array, trsum.begin(), trsum.end(), [](const Value &x){return x;})},
+						{"wallets", wsum}
+					};
 				}break;
 				default:
 					req.sendErrorPage(404);
@@ -2381,35 +2750,21 @@ void WebCfg::DataDownloaderTask::operator()() {
 
 }
 void WebCfg::DataDownloaderTask::done() {
-	Array out;
+	std::vector<double> out;
 	out.reserve(cnt);
-    while (!datastack.empty()) {
-        const auto &p = datastack.top();
-        std::visit([&](const auto &x){
-           using T = std::remove_const_t<std::remove_reference_t<decltype(x)> >;
-           if constexpr(std::is_same_v<T, IHistoryDataSource::MinuteData>) {
-               for (double d: x) {
-                   out.push_back(d);
-               }
-           } else {
-               for (const auto &ohlc: x) {
-                   double du = ohlc.high-ohlc.open;
-                   double dw = ohlc.open-ohlc.low;
-                   if (du > 2*dw) {
-                       out.push_back(ohlc.high);
-                   } else if (dw > 2*du) {
-                       out.push_back(ohlc.low);
-                   } else {
-                       out.push_back(ohlc.close);
-                   }
-               }
-           }
-        }, p);
-        datastack.pop();
-    }
+	while (!datastack.empty()) {
+		const auto &top = datastack.top();
+		if (auto part = std::get_if<IHistoryDataSource::MinuteData>(&top)) {
+			out.insert(out.end(), part->begin(), part->end());
+		} else {
+			auto conv = MinuteHistoryCache::toMinuteData(top);
+			out.insert(out.end(), conv.begin(), conv.end());
+		}
+		datastack.pop();
+	}
 
 	auto storage = state.lock_shared()->backtest_storage;
-	storage.lock()->store_data(out, dwnid);
+	storage.lock()->store_data(BTColumns::create(out), dwnid);
 }
 
 
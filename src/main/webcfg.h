@@ -10,8 +10,11 @@
 
 #include <shared/stringview.h>
 #include <shared/shared_function.h>
+#include <shared/worker.h>
 #include <simpleServer/http_parser.h>
 #include <imtjson/namedEnum.h>
+#include <atomic>
+#include <memory>
 #include <mutex>
 
 #include <shared/ini_config.h>
@@ -58,7 +61,7 @@ public:
 	};
 
 	struct SpreadCacheItem {
-		MTrader::Chart chart;
+		MTrader::ChartBuffer chart;
 		bool invert_price;
 	};
 
@@ -141,7 +144,8 @@ public:
 			json::PJWTCrypto jwt,
 			shared_lockable_ptr<AbstractExtern> backtest_broker,
 			std::size_t upload_limit,
-			std::size_t share_limit
+			std::size_t share_limit,
+			std::string tick_import_path
 	);
 
 	~WebCfg();
@@ -208,6 +212,19 @@ protected:
 	shared_lockable_ptr<AbstractExtern> backtest_broker;
 	std::size_t upload_limit;
     std::size_t share_limit;
+	///Directory with tick data files, which can be imported by the backtest (empty = disabled)
+	std::string tick_import_path;
+
+	///Runs parameter sweeps - shared by all requests, count of threads is bound to count of cpus
+	struct SweepControl {
+		ondra_shared::Worker worker;
+		///count of running sweeps
+		std::atomic<unsigned int> active = 0;
+		SweepControl(unsigned int threads):worker(ondra_shared::Worker::create(threads)) {}
+	};
+	std::shared_ptr<SweepControl> sweeps;
+	///Maximum count of sweeps running at the same time, other requests are rejected
+	static const unsigned int max_concurrent_sweeps = 2;
 
 
 
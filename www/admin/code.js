@@ -3038,6 +3038,8 @@ App.prototype.optionsForm = function() {
 				});
 			}
 			f.items = items;
+			//traders run in parallel, so the wall time of the round is the total
+			if (data.round !== undefined) total = data.reset + data.round;
 			f.total_p = {".style.width":(total/600).toFixed(1)+"%"};
 			f.total_v = (total/600).toFixed(1);
 			form.setData(f);
@@ -17,10 +17,23 @@ var svcreg = Promise.resolve(null);
 var notifyTradesFn = null;
 var is_admin = null;
 
+var ohlc_cache = {};
 function fetch_ohlc(stats, symbol, interval) {
     if (!stats.ohlc[symbol] || stats.ohlc[symbol].interval != interval) {
-        var p = fetch("api/ohlc?trader="+encodeURIComponent(symbol)+"&interval="+encodeURIComponent(interval))
-			.then(function(x) {return x.json();});
+        //bars already loaded are kept, only bars starting at the last bar are fetched
+        var prev = ohlc_cache[symbol];
+        var after = prev && prev.interval == interval && prev.data.length?prev.data[prev.data.length-1][0]:0;
+        var url = "api/ohlc?trader="+encodeURIComponent(symbol)+"&interval="+encodeURIComponent(interval);
+        if (after) url = url + "&after=" + after;
+        var p = fetch(url)
+			.then(function(x) {return x.json();})
+			.then(function(d) {
+			    if (after) {
+			        d = prev.data.filter(function(x) {return x[0] < after;}).concat(d);
+			    }
+			    ohlc_cache[symbol] = {interval: interval, data: d};
+			    return d;
+			});
         p.catch(function(e){
             console.error(e);
             delete stats.ohlc[symbol];